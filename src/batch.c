@@ -0,0 +1,303 @@
+//========================================================//
+//  batch.c                                               //
+//  Source file for the Multi-Trace Batch Runner          //
+//                                                        //
+//  Each trace gets its own predictor and trace reader,   //
+//  so the traces share nothing and run on separate       //
+//  threads.  Traces are handed out biggest file first so //
+//  that the longest one starts immediately and the total //
+//  wall time approaches that of the slowest trace.       //
+//========================================================//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "libpredictor.h"
+#include "trace.h"
+#include "batch.h"
+
+// Branches handed to the predictor library per call
+#define BATCH_BRANCHES  4096
+
+struct job {
+  char *path;
+  char *name;
+  off_t size;
+  int ok;
+  uint64_t num_branches;
+  uint64_t mispredictions;
+};
+
+struct batch {
+  struct job *jobs;
+  int njobs;
+  struct job **order;  // jobs, largest file first
+  int next;            // next entry of 'order' to run
+  bp_config config;
+  int nthreads;        // decoder threads per trace, 0 shares out the cores
+  int cores;
+  int active;          // traces being run
+  pthread_mutex_t lock;
+};
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+add_job(struct batch *b, const char *path)
+{
+  struct stat st;
+  if (!strcmp(path, "-")) {
+    // stdin, e.g. piped from tracegen
+    st.st_size = 0;
+  } else if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+    fprintf(stderr,"Unable to open trace %s\n", path);
+    return 0;
+  }
+
+  struct job *grown = realloc(b->jobs, (b->njobs + 1) * sizeof(struct job));
+  if (!grown) {
+    return 0;
+  }
+  b->jobs = grown;
+
+  struct job *j = &b->jobs[b->njobs++];
+  memset(j, 0, sizeof(struct job));
+  j->path = strdup(path);
+  j->size = st.st_size;
+
+  // Name the trace after its file, without directory and .bz2
+  const char *base = strrchr(path, '/');
+  j->name = strdup(!strcmp(path, "-") ? "stdin" : base ? base + 1 : path);
+  size_t n = strlen(j->name);
+  if (n > 4 && !strcmp(j->name + n - 4, ".bz2")) {
+    j->name[n - 4] = '\0';
+  }
+  return 1;
+}
+
+static int
+by_name(const void *a, const void *b)
+{
+  return strcmp(((const struct job *)a)->name, ((const struct job *)b)->name);
+}
+
+static int
+by_size_desc(const void *a, const void *b)
+{
+  off_t sa = (*(struct job * const *)a)->size;
+  off_t sb = (*(struct job * const *)b)->size;
+  return (sa < sb) - (sa > sb);
+}
+
+// Collect the traces named by 'spec'
+//
+static int
+collect_jobs(struct batch *b, const char *spec)
+{
+  struct stat st;
+
+  if (stat(spec, &st) == 0 && S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(spec);
+    struct dirent *de;
+    if (!dir) {
+      fprintf(stderr,"Unable to open directory %s\n", spec);
+      return 0;
+    }
+    while ((de = readdir(dir)) != NULL) {
+      if (de->d_name[0] == '.') {
+        continue;
+      }
+      char *path = malloc(strlen(spec) + strlen(de->d_name) + 2);
+      sprintf(path, "%s/%s", spec, de->d_name);
+      struct stat est;
+      if (stat(path, &est) == 0 && S_ISREG(est.st_mode)) {
+        add_job(b, path);
+      }
+      free(path);
+    }
+    closedir(dir);
+  } else {
+    char *list = strdup(spec);
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+      if (!add_job(b, tok)) {
+        free(list);
+        return 0;
+      }
+    }
+    free(list);
+  }
+
+  if (b->njobs == 0) {
+    fprintf(stderr,"No traces found in %s\n", spec);
+    return 0;
+  }
+  qsort(b->jobs, b->njobs, sizeof(struct job), by_name);
+
+  b->order = malloc(b->njobs * sizeof(struct job *));
+  if (!b->order) {
+    return 0;
+  }
+  for (int i = 0; i < b->njobs; i++) {
+    b->order[i] = &b->jobs[i];
+  }
+  qsort(b->order, b->njobs, sizeof(struct job *), by_size_desc);
+  return 1;
+}
+
+static void
+run_job(struct batch *b, struct job *j, int nthreads)
+{
+  trace_t *trace = trace_open(j->path, nthreads, 0);
+  if (trace == NULL) {
+    fprintf(stderr,"Unable to open trace %s\n", j->path);
+    return;
+  }
+
+  bp_predictor *p = bp_create(&b->config, NULL);
+  if (p == NULL) {
+    fprintf(stderr,"Unable to create predictor for %s\n", j->path);
+    trace_close(trace);
+    return;
+  }
+
+  bp_branch branches[BATCH_BRANCHES];
+  uint32_t pc = 0;
+  uint8_t outcome = BP_NOTTAKEN;
+  size_t n;
+  do {
+    for (n = 0; n < BATCH_BRANCHES && trace_read_branch(trace, &pc, &outcome); n++) {
+      branches[n].pc = pc;
+      branches[n].outcome = outcome;
+    }
+    bp_run(p, branches, n, NULL, NULL);
+  } while (n == BATCH_BRANCHES);
+
+  bp_stats stats;
+  bp_get_stats(p, &stats);
+  j->num_branches = stats.branches;
+  j->mispredictions = stats.mispredictions;
+
+  j->ok = !trace_error(trace);
+  if (!j->ok) {
+    fprintf(stderr,"Warning: trace %s is truncated or corrupt\n", j->path);
+  }
+  bp_destroy(p);
+  trace_close(trace);
+}
+
+static void *
+worker_main(void *arg)
+{
+  struct batch *b = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&b->lock);
+    struct job *j = b->next < b->njobs ? b->order[b->next++] : NULL;
+    // Split the cores between this trace, the traces still running and
+    // those still waiting, so the last traces to start get the cores
+    // the others no longer need
+    int nthreads = b->nthreads;
+    if (nthreads == 0) {
+      nthreads = b->cores / (b->active + 1 + b->njobs - b->next);
+      nthreads = nthreads > 0 ? nthreads : 1;
+    }
+    b->active += (j != NULL);
+    pthread_mutex_unlock(&b->lock);
+    if (j == NULL) {
+      break;
+    }
+    run_job(b, j, nthreads);
+
+    pthread_mutex_lock(&b->lock);
+    b->active--;
+    pthread_mutex_unlock(&b->lock);
+  }
+
+  return NULL;
+}
+
+static void
+print_stats(const char *name, uint64_t num_branches, uint64_t mispredictions)
+{
+  printf("%s\n", name);
+  printf("Branches:        %10llu\n", (unsigned long long)num_branches);
+  printf("Incorrect:       %10llu\n", (unsigned long long)mispredictions);
+  float mispredict_rate = 100*((float)mispredictions / (float)num_branches);
+  printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+}
+
+int
+run_batch(const char *spec, const bp_config *cfg, int nthreads)
+{
+  struct batch b;
+  memset(&b, 0, sizeof(b));
+  b.config = *cfg;
+  b.nthreads = nthreads > 0 ? nthreads : 0;
+
+  if (!collect_jobs(&b, spec)) {
+    return 1;
+  }
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  b.cores = cores > 0 ? (int)cores : 1;
+  int nworkers = b.cores;
+  if (nworkers > b.njobs) {
+    nworkers = b.njobs;
+  }
+
+  double start = now();
+  pthread_mutex_init(&b.lock, NULL);
+  pthread_t *workers = malloc(nworkers * sizeof(pthread_t));
+  int started = 0;
+  for (int i = 0; i < nworkers; i++) {
+    if (pthread_create(&workers[i], NULL, worker_main, &b) != 0) {
+      break;
+    }
+    started++;
+  }
+  if (started == 0) {
+    worker_main(&b);
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  double wall = now() - start;
+
+  // Print out the mispredict statistics, per trace and in total
+  uint64_t total_branches = 0;
+  uint64_t total_mispredictions = 0;
+  int failed = 0;
+  for (int i = 0; i < b.njobs; i++) {
+    struct job *j = &b.jobs[i];
+    print_stats(j->name, j->num_branches, j->mispredictions);
+    total_branches += j->num_branches;
+    total_mispredictions += j->mispredictions;
+    failed |= !j->ok;
+  }
+  print_stats("Total", total_branches, total_mispredictions);
+  printf("Traces:          %10d\n", b.njobs);
+  printf("Wall time (s):   %10.3f\n", wall);
+  printf("Branches/sec:    %10.0f\n", wall > 0 ? total_branches / wall : 0.0);
+
+  pthread_mutex_destroy(&b.lock);
+  for (int i = 0; i < b.njobs; i++) {
+    free(b.jobs[i].path);
+    free(b.jobs[i].name);
+  }
+  free(b.jobs);
+  free(b.order);
+  free(workers);
+
+  return failed;
+}
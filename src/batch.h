@@ -0,0 +1,25 @@
+//========================================================//
+//  batch.h                                               //
+//  Header file for the Multi-Trace Batch Runner          //
+//                                                        //
+//  Runs one predictor instance per trace, with traces    //
+//  scheduled across cores largest first                  //
+//========================================================//
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "libpredictor.h"
+
+// Run every trace named by 'spec' with a predictor configured by 'cfg'
+// and print per-trace and aggregate statistics on stdout.  'spec' is
+// either a directory, whose files are all used as traces, or a comma
+// separated list of trace files, where "-" is stdin.  'nthreads' is the
+// number of bzip2 decoder threads per trace; 0 divides the cores among
+// the traces running or waiting when each trace starts.
+//
+// Returns 0 if every trace was processed, 1 otherwise
+//
+int run_batch(const char *spec, const bp_config *cfg, int nthreads);
+
+#endif
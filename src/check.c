@@ -0,0 +1,500 @@
+//========================================================//
+//  check.c                                               //
+//  Differential Verification of the Branch Predictors    //
+//                                                        //
+//  Runs the reference predictors of predictor_ref.c and  //
+//  every engine listed in 'engines' in lockstep over the //
+//  same traces.  Any difference in a prediction, in the  //
+//  history or in any table entry is reported with the    //
+//  branch where it first appeared and the state of both  //
+//  predictors.  Misprediction counts can also be checked //
+//  against a log_run_*_predictor file.                   //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "predictor.h"
+#include "predictor_ref.h"
+#include "trace.h"
+
+// One implementation of the predictors
+typedef struct {
+  const char *name;
+  int (*alloc)(predictor_t *p);
+  uint8_t (*predict)(predictor_t *p, uint32_t pc);
+  void (*train)(predictor_t *p, uint32_t pc, uint8_t outcome);
+  void (*free)(predictor_t *p);
+} engine_t;
+
+engine_t reference = { "reference", ref_predictor_alloc, ref_predictor_predict,
+                       ref_predictor_train, ref_predictor_free };
+
+// Engines checked against the reference.  Add every faster
+// implementation of the predictors here.
+engine_t engines[] = {
+  { "predictor.c", predictor_alloc, predictor_predict,
+    predictor_train, predictor_free },
+};
+#define NUM_ENGINES  (int)(sizeof(engines) / sizeof(engines[0]))
+
+// Results of the lockstep run
+#define CHECK_OK        0
+#define CHECK_DIVERGED  1   // reported at the exact branch
+#define CHECK_RERUN     2   // tables differ at a checkpoint
+#define CHECK_ERROR     3
+
+// A table of predictor state
+typedef struct {
+  const char *name;
+  const void *data;
+  size_t entries;
+  int width;           // bytes per entry
+  int is_signed;
+} table_t;
+
+// Expected results read from a log_run_*_predictor file
+typedef struct {
+  char name[64];
+  uint64_t branches;
+  uint64_t mispredictions;
+  int checked;         // a trace of this name was run
+} expect_t;
+
+int types[4];
+int num_types = 0;
+uint64_t interval = 4096;
+expect_t *expected = NULL;
+int num_expected = 0;
+const char *expect_path = NULL;
+
+//------------------------------------//
+//           State Inspection         //
+//------------------------------------//
+
+int
+get_tables(const predictor_t *p, table_t t[4])
+{
+  switch (p->bpType) {
+    case STATIC:
+    case GSHARE:
+      t[0] = (table_t){ "bht_gshare", p->bht_gshare,
+                        (size_t)1 << p->ghistoryBits, 1, 0 };
+      return 1;
+    case TOURNAMENT:
+      t[0] = (table_t){ "tournament_bht_gp", p->tournament_bht_gp,
+                        (size_t)1 << p->tournament_gp_len, 1, 0 };
+      t[1] = (table_t){ "tournament_ct", p->tournament_ct,
+                        (size_t)1 << p->tournament_choice_len, 1, 0 };
+      t[2] = (table_t){ "tournament_lht", p->tournament_lht,
+                        (size_t)1 << p->tournament_lht_len, 2, 0 };
+      t[3] = (table_t){ "tournament_bht_lp", p->tournament_bht_lp,
+                        (size_t)1 << p->tournament_lp_len, 1, 0 };
+      return 4;
+    case CUSTOM:
+      t[0] = (table_t){ "perceptron_table", p->perceptron_table,
+                        (size_t)p->num_perceptrons *
+                        (p->perceptron_history_len + 1), 2, 1 };
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+long
+table_value(const table_t *t, size_t i)
+{
+  if (t->width == 1) {
+    return ((const uint8_t *)t->data)[i];
+  }
+  if (t->is_signed) {
+    return ((const int16_t *)t->data)[i];
+  }
+  return ((const uint16_t *)t->data)[i];
+}
+
+// Compare the complete state of two predictors
+//
+// Returns True if it matches, otherwise describes the first
+// difference in 'where'
+//
+int
+same_state(const predictor_t *a, const predictor_t *b, char *where, size_t len)
+{
+  table_t ta[4], tb[4];
+  int n = get_tables(a, ta);
+  get_tables(b, tb);
+
+  if (a->ghistory != b->ghistory) {
+    snprintf(where, len, "ghistory: reference 0x%llx, engine 0x%llx",
+             (unsigned long long)a->ghistory, (unsigned long long)b->ghistory);
+    return 0;
+  }
+  for (int k = 0; k < n; k++) {
+    if (!memcmp(ta[k].data, tb[k].data, ta[k].entries * ta[k].width)) {
+      continue;
+    }
+    for (size_t i = 0; i < ta[k].entries; i++) {
+      if (table_value(&ta[k], i) != table_value(&tb[k], i)) {
+        snprintf(where, len, "%s[%zu]: reference %ld, engine %ld",
+                 ta[k].name, i, table_value(&ta[k], i), table_value(&tb[k], i));
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// Print the state a predictor uses for the branch at 'pc'
+//
+void
+dump_state(const char *who, const predictor_t *p, uint32_t pc)
+{
+  uint32_t index, lht_index;
+
+  printf("  %s state: ghistory 0x%llx\n", who, (unsigned long long)p->ghistory);
+  switch (p->bpType) {
+    case STATIC:
+    case GSHARE:
+      index = (pc ^ p->ghistory) & ((1u << p->ghistoryBits) - 1);
+      printf("    bht_gshare[%u] = %d\n", index, p->bht_gshare[index]);
+      break;
+    case TOURNAMENT:
+      index = p->ghistory & ((1u << p->tournament_gp_len) - 1);
+      lht_index = pc & ((1u << p->tournament_lht_len) - 1);
+      printf("    tournament_bht_gp[%u] = %d\n", index,
+             p->tournament_bht_gp[index]);
+      printf("    tournament_ct[%u] = %d\n", index, p->tournament_ct[index]);
+      printf("    tournament_lht[%u] = %u\n", lht_index,
+             p->tournament_lht[lht_index]);
+      printf("    tournament_bht_lp[%u] = %d\n", p->tournament_lht[lht_index],
+             p->tournament_bht_lp[p->tournament_lht[lht_index]]);
+      break;
+    case CUSTOM:
+      index = (pc % p->num_perceptrons) * (p->perceptron_history_len + 1);
+      printf("    perceptron_table[%u..%u] =", index,
+             index + p->perceptron_history_len);
+      int16_t y = p->perceptron_table[index];
+      for (int i = 0; i <= p->perceptron_history_len; i++) {
+        printf(" %d", p->perceptron_table[index + i]);
+        if (i > 0) {
+          y += ((p->ghistory >> (i - 1)) & 1) ? p->perceptron_table[index + i]
+                                              : -p->perceptron_table[index + i];
+        }
+      }
+      printf("\n    y = %d\n", y);
+      break;
+    default:
+      break;
+  }
+}
+
+void
+report(const char *trace_name, const engine_t *e, uint64_t branch,
+       uint32_t pc, uint8_t outcome, const char *what,
+       const predictor_t *ref, const predictor_t *eng)
+{
+  printf("MISMATCH: engine '%s' differs from the reference on %s (%s)\n",
+         e->name, trace_name, bpName[ref->bpType]);
+  printf("  branch %llu: pc 0x%x outcome %d\n",
+         (unsigned long long)branch, pc, outcome);
+  printf("  %s\n", what);
+  dump_state("reference", ref, pc);
+  dump_state(e->name, eng, pc);
+}
+
+//------------------------------------//
+//           Lockstep Runner          //
+//------------------------------------//
+
+// Run the reference and engine 'e' side by side over 'path'.  The
+// predictions and histories are compared after every branch, the
+// tables every 'interval' branches and after every branch from
+// 'exact_from' on.  '*last_good' receives the last branch count at
+// which all state was found equal.
+//
+int
+lockstep(const char *path, const char *trace_name, int type, const engine_t *e,
+         uint64_t exact_from, uint64_t *last_good,
+         uint64_t *num_branches, uint64_t *mispredictions)
+{
+  predictor_t ref, eng;
+  char where[256];
+  int status = CHECK_OK;
+
+  trace_t *trace = trace_open(path, 0, 0);
+  if (trace == NULL) {
+    printf("ERROR: unable to open trace %s\n", path);
+    return CHECK_ERROR;
+  }
+  predictor_defaults(&ref, type);
+  predictor_defaults(&eng, type);
+  if (!reference.alloc(&ref) || !e->alloc(&eng)) {
+    printf("ERROR: out of memory\n");
+    trace_close(trace);
+    return CHECK_ERROR;
+  }
+
+  uint64_t n = 0;
+  uint64_t miss = 0;
+  uint32_t pc = 0;
+  uint8_t outcome = NOTTAKEN;
+  *last_good = 0;
+
+  while (trace_read_branch(trace, &pc, &outcome)) {
+    uint8_t ref_prediction = reference.predict(&ref, pc);
+    uint8_t eng_prediction = e->predict(&eng, pc);
+    if (ref_prediction != eng_prediction) {
+      snprintf(where, sizeof(where), "prediction: reference %d, engine %d",
+               ref_prediction, eng_prediction);
+      report(trace_name, e, n, pc, outcome, where, &ref, &eng);
+      status = CHECK_DIVERGED;
+      break;
+    }
+    miss += (ref_prediction != outcome);
+
+    reference.train(&ref, pc, outcome);
+    e->train(&eng, pc, outcome);
+    n++;
+
+    int full = (n >= exact_from) || (n % interval == 0);
+    if (ref.ghistory != eng.ghistory ||
+        (full && !same_state(&ref, &eng, where, sizeof(where)))) {
+      if (ref.ghistory != eng.ghistory) {
+        same_state(&ref, &eng, where, sizeof(where));
+      } else if (n < exact_from && n - *last_good > 1) {
+        // Somewhere since the last checkpoint, find out where
+        status = CHECK_RERUN;
+        break;
+      }
+      report(trace_name, e, n - 1, pc, outcome, where, &ref, &eng);
+      status = CHECK_DIVERGED;
+      break;
+    }
+    if (full) {
+      *last_good = n;
+    }
+  }
+
+  // Final table contents
+  if (status == CHECK_OK && !same_state(&ref, &eng, where, sizeof(where))) {
+    status = CHECK_RERUN;
+  }
+  if (status == CHECK_OK && trace_error(trace)) {
+    printf("ERROR: trace %s is truncated or corrupt\n", path);
+    status = CHECK_ERROR;
+  }
+
+  *num_branches = n;
+  *mispredictions = miss;
+  reference.free(&ref);
+  e->free(&eng);
+  trace_close(trace);
+  return status;
+}
+
+//------------------------------------//
+//          Expected Results          //
+//------------------------------------//
+
+// Read the per-trace results of a run_*.sh log
+//
+int
+read_expected(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  char line[256];
+  expect_t *cur = NULL;
+
+  if (!f) {
+    return 0;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long long v;
+    line[strcspn(line, "\r\n")] = '\0';
+    if (sscanf(line, "Branches: %llu", &v) == 1 && cur) {
+      cur->branches = v;
+    } else if (sscanf(line, "Incorrect: %llu", &v) == 1 && cur) {
+      cur->mispredictions = v;
+    } else if (line[0] && !strpbrk(line, " :") && strlen(line) < 64) {
+      // A trace name
+      expected = realloc(expected, (num_expected + 1) * sizeof(expect_t));
+      cur = &expected[num_expected++];
+      memset(cur, 0, sizeof(expect_t));
+      strcpy(cur->name, line);
+    }
+  }
+  fclose(f);
+  return 1;
+}
+
+expect_t *
+find_expected(const char *name)
+{
+  for (int i = 0; i < num_expected; i++) {
+    if (!strcmp(expected[i].name, name)) {
+      expected[i].checked = 1;
+      return &expected[i];
+    }
+  }
+  return NULL;
+}
+
+//------------------------------------//
+//                Main                //
+//------------------------------------//
+
+void
+usage()
+{
+  fprintf(stderr,"Usage: check_predictor <options> <trace>...\n");
+  fprintf(stderr," Options:\n");
+  fprintf(stderr," --help           Print this message\n");
+  fprintf(stderr," --<type>         Predictor to check, may be repeated\n"
+                 "                  (static, gshare, tournament, custom;\n"
+                 "                  default all)\n");
+  fprintf(stderr," --expect:<log>   Also require the misprediction counts\n"
+                 "                  recorded in a log_run_*_predictor file,\n"
+                 "                  for exactly the traces in the log\n");
+  fprintf(stderr," --interval:<n>   Compare whole tables every <n> branches\n"
+                 "                  (default 4096)\n");
+}
+
+// Add a predictor type to check, once
+//
+void
+add_type(int type)
+{
+  for (int i = 0; i < num_types; i++) {
+    if (types[i] == type) {
+      return;
+    }
+  }
+  types[num_types++] = type;
+}
+
+int
+handle_option(char *arg)
+{
+  if (!strcmp(arg,"--static")) {
+    add_type(STATIC);
+  } else if (!strcmp(arg,"--gshare")) {
+    add_type(GSHARE);
+  } else if (!strcmp(arg,"--tournament")) {
+    add_type(TOURNAMENT);
+  } else if (!strcmp(arg,"--custom")) {
+    add_type(CUSTOM);
+  } else if (!strncmp(arg,"--expect:",9)) {
+    expect_path = arg + 9;
+  } else if (!strncmp(arg,"--interval:",11)) {
+    interval = strtoull(arg + 11, NULL, 0);
+  } else {
+    return 0;
+  }
+
+  return interval > 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char **traces = malloc(argc * sizeof(char *));
+  int num_traces = 0;
+  int failed = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i],"--help")) {
+      usage();
+      exit(0);
+    } else if (!strncmp(argv[i],"--",2)) {
+      if (!handle_option(argv[i])) {
+        printf("Unrecognized option %s\n", argv[i]);
+        usage();
+        exit(1);
+      }
+    } else {
+      traces[num_traces++] = argv[i];
+    }
+  }
+  if (num_traces == 0) {
+    usage();
+    exit(1);
+  }
+  if (num_types == 0) {
+    types[num_types++] = STATIC;
+    types[num_types++] = GSHARE;
+    types[num_types++] = TOURNAMENT;
+    types[num_types++] = CUSTOM;
+  }
+  if (expect_path && (!read_expected(expect_path) || num_expected == 0)) {
+    printf("Unable to read any results from %s\n", expect_path);
+    exit(1);
+  }
+
+  for (int t = 0; t < num_traces; t++) {
+    // Name the trace after its file, without directory and .bz2
+    char name[64];
+    const char *base = strrchr(traces[t], '/');
+    snprintf(name, sizeof(name), "%s", base ? base + 1 : traces[t]);
+    size_t len = strlen(name);
+    if (len > 4 && !strcmp(name + len - 4, ".bz2")) {
+      name[len - 4] = '\0';
+    }
+
+    for (int k = 0; k < num_types; k++) {
+      for (int e = 0; e < NUM_ENGINES; e++) {
+        uint64_t last_good, n, miss;
+        int status = lockstep(traces[t], name, types[k], &engines[e],
+                              UINT64_MAX, &last_good, &n, &miss);
+        if (status == CHECK_RERUN) {
+          uint64_t checkpoint = last_good;
+          status = lockstep(traces[t], name, types[k], &engines[e],
+                            last_good, &last_good, &n, &miss);
+          if (status == CHECK_OK) {
+            printf("MISMATCH: engine '%s' differs from the reference on %s "
+                   "(%s) since branch %llu, but not when run again\n",
+                   engines[e].name, name, bpName[types[k]],
+                   (unsigned long long)checkpoint);
+            status = CHECK_DIVERGED;
+          }
+        }
+        if (status != CHECK_OK) {
+          failed = 1;
+          continue;
+        }
+
+        const expect_t *x = expect_path ? find_expected(name) : NULL;
+        const char *verdict = "OK";
+        if (expect_path && !x) {
+          verdict = "NOT IN LOG";
+          failed = 1;
+        } else if (x && (x->branches != n || x->mispredictions != miss)) {
+          verdict = "WRONG COUNT";
+          failed = 1;
+        }
+        printf("%-12s %-10s %-12s %10llu branches %10llu incorrect  %s\n",
+               name, bpName[types[k]], engines[e].name,
+               (unsigned long long)n, (unsigned long long)miss, verdict);
+        if (x && strcmp(verdict, "OK")) {
+          printf("  expected %llu branches %llu incorrect from %s\n",
+                 (unsigned long long)x->branches,
+                 (unsigned long long)x->mispredictions, expect_path);
+        }
+      }
+    }
+  }
+
+  // Every result in the log must have been checked
+  for (int i = 0; i < num_expected; i++) {
+    if (!expected[i].checked) {
+      printf("MISSING: %s has results in %s but was not run\n",
+             expected[i].name, expect_path);
+      failed = 1;
+    }
+  }
+
+  free(traces);
+  free(expected);
+  return failed;
+}
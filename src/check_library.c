@@ -0,0 +1,222 @@
+//========================================================//
+//  check_library.c                                       //
+//  Link and Run Check of the libpredictor Interface      //
+//                                                        //
+//  Built like a simulator embedding the library: against //
+//  libpredictor.a and against libpredictor.so, with      //
+//  globals of its own that share names with predictor.c. //
+//  Checks that every way of driving a predictor through  //
+//  libpredictor.h gives the same predictions, that saved //
+//  state restores exactly and that damaged state is      //
+//  refused.                                              //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libpredictor.h"
+
+#define NUM_BRANCHES  200000
+
+// Names an embedding program may well use itself.  The link fails
+// if the library exports its internal definitions of them.
+int verbose = 1;
+int bpType = -1;
+int ghistoryBits = -1;
+const char *email = "host";
+
+const char *typeName[4] = { "static", "gshare", "tournament", "custom" };
+
+uint32_t pcs[NUM_BRANCHES];
+uint8_t outcomes[NUM_BRANCHES];
+bp_branch branches[NUM_BRANCHES];
+
+int failures = 0;
+
+void
+expect(int ok, const char *type, const char *what)
+{
+  if (!ok) {
+    printf("FAILED: %s: %s\n", type, what);
+    failures++;
+  }
+}
+
+// A few hundred static branches with loop, biased and history
+// correlated behaviour
+//
+void
+make_branches()
+{
+  uint64_t x = 12345;
+  uint64_t history = 0;
+
+  for (int i = 0; i < NUM_BRANCHES; i++) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint32_t r = x >> 33;
+    uint32_t pc = 0x400000 + 4 * (r % 300);
+    uint8_t o;
+    switch (pc % 3) {
+      case 0:
+        o = (i % 8) != 7;
+        break;
+      case 1:
+        o = (r >> 12) % 10 != 0;
+        break;
+      default:
+        o = (history >> 2) & 1;
+        break;
+    }
+    pcs[i] = pc;
+    outcomes[i] = o;
+    branches[i].pc = pc;
+    branches[i].outcome = o;
+    history = (history << 1) | o;
+  }
+}
+
+// Overwrite an entry of saved state 'state' with an out of range
+// value: in the last table, or for the tournament predictor in the
+// local history table in front of the local predictor
+//
+void
+corrupt_state(int type, const bp_config *cfg, char *state, size_t len)
+{
+  uint16_t history = 0xffff;
+  int16_t weight = 0x7fff;
+
+  switch (type) {
+    case BP_TOURNAMENT:
+      memcpy(state + len - ((size_t)1 << cfg->tournament_lp_len) - 2,
+             &history, sizeof(history));
+      break;
+    case BP_CUSTOM:
+      memcpy(state + len - 2, &weight, sizeof(weight));
+      break;
+    default:
+      state[len - 1] = 0xff;  // 2-bit counter
+      break;
+  }
+}
+
+void
+check_type(int type)
+{
+  const char *name = typeName[type];
+  static uint8_t pred_run[NUM_BRANCHES], pred_arrays[NUM_BRANCHES];
+  static uint8_t pred_single[NUM_BRANCHES], pred_restored[NUM_BRANCHES];
+  static int16_t conf_run[NUM_BRANCHES], conf_arrays[NUM_BRANCHES];
+  bp_config cfg;
+  bp_stats s1, s2;
+  int err;
+  int before = failures;
+
+  bp_config_init(&cfg, type);
+  bp_predictor *a = bp_create(&cfg, &err);
+  bp_predictor *b = bp_create(&cfg, &err);
+  bp_predictor *c = bp_create(&cfg, &err);
+  if (!a || !b || !c) {
+    expect(0, name, "bp_create");
+    bp_destroy(a);
+    bp_destroy(b);
+    bp_destroy(c);
+    return;
+  }
+
+  // bp_run, bp_run_arrays and single branches agree
+  size_t miss = bp_run(a, branches, NUM_BRANCHES, pred_run, conf_run);
+  bp_run_arrays(b, pcs, outcomes, NUM_BRANCHES, pred_arrays, conf_arrays);
+  for (int i = 0; i < NUM_BRANCHES; i++) {
+    int16_t conf = bp_confidence(c, pcs[i]);
+    pred_single[i] = bp_predict(c, pcs[i]);
+    bp_train(c, pcs[i], outcomes[i]);
+    if (conf != conf_run[i]) {
+      expect(0, name, "bp_confidence differs from bp_run");
+      break;
+    }
+  }
+  expect(!memcmp(pred_run, pred_arrays, NUM_BRANCHES) &&
+         !memcmp(conf_run, conf_arrays, sizeof(conf_run)), name,
+         "bp_run_arrays differs from bp_run");
+  expect(!memcmp(pred_run, pred_single, NUM_BRANCHES), name,
+         "bp_predict differs from bp_run");
+  bp_get_stats(a, &s1);
+  bp_get_stats(c, &s2);
+  expect(s1.branches == NUM_BRANCHES && s1.mispredictions == miss &&
+         s2.branches == s1.branches && s2.mispredictions == s1.mispredictions,
+         name, "statistics");
+  bp_reset_stats(c);
+  bp_get_stats(c, &s2);
+  expect(s2.branches == 0 && s2.mispredictions == 0, name, "bp_reset_stats");
+  bp_destroy(b);
+  bp_destroy(c);
+
+  // State saved half way and restored into a new predictor continues
+  // exactly like the original
+  size_t half = NUM_BRANCHES / 2;
+  bp_destroy(a);
+  a = bp_create(&cfg, &err);
+  b = bp_create(&cfg, &err);
+  bp_run(a, branches, half, NULL, NULL);
+  size_t len = bp_serialize(a, NULL, 0);
+  char *state = malloc(len);
+  expect(state && bp_serialize(a, state, len) == len, name, "bp_serialize");
+  expect(bp_deserialize(b, state, len - 1) != BP_OK, name,
+         "bp_deserialize accepted truncated state");
+  char *bad = malloc(len);
+  memcpy(bad, state, len);
+  corrupt_state(type, &cfg, bad, len);
+  expect(bp_deserialize(b, bad, len) == BP_EINVAL, name,
+         "bp_deserialize accepted out of range table entries");
+  free(bad);
+  expect(bp_deserialize(b, state, len) == BP_OK, name, "bp_deserialize");
+  bp_run(a, branches + half, NUM_BRANCHES - half, pred_run + half, NULL);
+  bp_run(b, branches + half, NUM_BRANCHES - half, pred_restored + half, NULL);
+  expect(!memcmp(pred_run + half, pred_restored + half, NUM_BRANCHES - half),
+         name, "restored predictor diverges");
+  bp_get_stats(a, &s1);
+  bp_get_stats(b, &s2);
+  expect(s1.branches == s2.branches && s1.mispredictions == s2.mispredictions,
+         name, "restored statistics");
+
+  // State of another configuration is refused
+  bp_config other;
+  bp_config_init(&other, type == BP_CUSTOM ? BP_GSHARE : BP_CUSTOM);
+  bp_predictor *o = bp_create(&other, &err);
+  expect(o && bp_deserialize(o, state, len) != BP_OK, name,
+         "bp_deserialize accepted another configuration");
+
+  printf("%-10s %8llu branches %8llu incorrect  %s\n", name,
+         (unsigned long long)s1.branches,
+         (unsigned long long)s1.mispredictions,
+         failures > before ? "FAILED" : "OK");
+
+  free(state);
+  bp_destroy(o);
+  bp_destroy(a);
+  bp_destroy(b);
+}
+
+int
+main(int argc, char *argv[])
+{
+  bp_config cfg;
+  int err = BP_OK;
+
+  expect(bp_abi_version() == BP_ABI_VERSION, "library", "bp_abi_version");
+  bp_config_init(&cfg, BP_GSHARE);
+  cfg.type = 7;
+  expect(bp_create(&cfg, &err) == NULL && err == BP_EINVAL, "library",
+         "bp_create accepted an invalid type");
+
+  make_branches();
+  for (int type = BP_STATIC; type <= BP_CUSTOM; type++) {
+    check_type(type);
+  }
+
+  // The host's own definitions were not replaced by the library's
+  expect(verbose == 1 && bpType == -1 && ghistoryBits == -1 &&
+         !strcmp(email, "host"), "library", "host globals");
+
+  return failures != 0;
+}
@@ -0,0 +1,415 @@
+//========================================================//
+//  libpredictor.c                                        //
+//  Public C interface of libpredictor                    //
+//                                                        //
+//  Thin layer over predictor_t that validates the        //
+//  configuration, keeps statistics and saves state.      //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "predictor.h"
+#include "libpredictor.h"
+
+#define STATE_MAGIC       "BPST"
+#define STATE_BYTE_ORDER  0x01020304u
+
+struct bp_predictor {
+  predictor_t p;
+  bp_config config;
+  bp_stats stats;
+
+  // Last bp_predict, matched against the next bp_train
+  int pending;
+  uint32_t pending_pc;
+  uint8_t pending_prediction;
+};
+
+// Header of a serialized state, followed by the tables
+struct state_header {
+  char magic[4];
+  uint32_t abi_version;
+  uint32_t byte_order;
+  uint32_t reserved;
+  bp_config config;
+  uint64_t ghistory;
+  bp_stats stats;
+};
+
+struct table {
+  void *data;
+  size_t bytes;
+};
+
+//------------------------------------//
+//              Helpers               //
+//------------------------------------//
+
+static int
+in_range(int32_t v, int32_t lo, int32_t hi)
+{
+  return v >= lo && v <= hi;
+}
+
+// Check that a configuration gives tables that are indexed in range
+//
+static int
+valid_config(const bp_config *c)
+{
+  switch (c->type) {
+    case BP_STATIC:
+    case BP_GSHARE:
+      return in_range(c->ghistory_bits, 1, 28);
+    case BP_TOURNAMENT:
+      // The global history indexes the choice table, and the local
+      // histories index the local predictor
+      return in_range(c->tournament_gp_len, 1, 28) &&
+             in_range(c->tournament_choice_len, c->tournament_gp_len, 28) &&
+             in_range(c->tournament_lht_len, 1, 16) &&
+             in_range(c->tournament_lp_len, c->tournament_lht_len, 28);
+    case BP_CUSTOM:
+      return in_range(c->perceptron_count, 1, 1 << 24) &&
+             in_range(c->perceptron_history_len, 1, 63);
+    default:
+      return 0;
+  }
+}
+
+// List the tables that make up the state of 'bp'
+//
+static int
+get_tables(const bp_predictor *bp, struct table t[4])
+{
+  const predictor_t *p = &bp->p;
+
+  switch (p->bpType) {
+    case STATIC:
+    case GSHARE:
+      t[0].data = p->bht_gshare;
+      t[0].bytes = (size_t)1 << p->ghistoryBits;
+      return 1;
+    case TOURNAMENT:
+      t[0].data = p->tournament_bht_gp;
+      t[0].bytes = (size_t)1 << p->tournament_gp_len;
+      t[1].data = p->tournament_ct;
+      t[1].bytes = (size_t)1 << p->tournament_choice_len;
+      t[2].data = p->tournament_lht;
+      t[2].bytes = ((size_t)1 << p->tournament_lht_len) * sizeof(uint16_t);
+      t[3].data = p->tournament_bht_lp;
+      t[3].bytes = (size_t)1 << p->tournament_lp_len;
+      return 4;
+    case CUSTOM:
+      t[0].data = p->perceptron_table;
+      t[0].bytes = (size_t)p->num_perceptrons *
+                   (p->perceptron_history_len + 1) * sizeof(int16_t);
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+//------------------------------------//
+//         Library Interface          //
+//------------------------------------//
+
+int
+bp_abi_version(void)
+{
+  return BP_ABI_VERSION;
+}
+
+void
+bp_config_init(bp_config *cfg, int type)
+{
+  predictor_t p;
+  predictor_defaults(&p, type);
+
+  memset(cfg, 0, sizeof(bp_config));
+  cfg->size = sizeof(bp_config);
+  cfg->type = type;
+  cfg->ghistory_bits = p.ghistoryBits;
+  cfg->tournament_gp_len = p.tournament_gp_len;
+  cfg->tournament_choice_len = p.tournament_choice_len;
+  cfg->tournament_lht_len = p.tournament_lht_len;
+  cfg->tournament_lp_len = p.tournament_lp_len;
+  cfg->perceptron_count = p.num_perceptrons;
+  cfg->perceptron_history_len = p.perceptron_history_len;
+}
+
+bp_predictor *
+bp_create(const bp_config *cfg, int *err)
+{
+  bp_config c;
+  int dummy;
+
+  if (err == NULL) {
+    err = &dummy;
+  }
+  if (cfg == NULL || cfg->size < offsetof(bp_config, type) + sizeof(int32_t)) {
+    *err = BP_EINVAL;
+    return NULL;
+  }
+
+  // Fields missing from an older caller's struct keep their defaults
+  bp_config_init(&c, cfg->type);
+  memcpy(&c, cfg, cfg->size < sizeof(c) ? cfg->size : sizeof(c));
+  c.size = sizeof(c);
+  if (!valid_config(&c)) {
+    *err = BP_EINVAL;
+    return NULL;
+  }
+
+  bp_predictor *bp = calloc(1, sizeof(bp_predictor));
+  if (bp == NULL) {
+    *err = BP_ENOMEM;
+    return NULL;
+  }
+  bp->config = c;
+
+  predictor_defaults(&bp->p, c.type);
+  bp->p.ghistoryBits = c.ghistory_bits;
+  bp->p.tournament_gp_len = c.tournament_gp_len;
+  bp->p.tournament_choice_len = c.tournament_choice_len;
+  bp->p.tournament_lht_len = c.tournament_lht_len;
+  bp->p.tournament_lp_len = c.tournament_lp_len;
+  bp->p.num_perceptrons = c.perceptron_count;
+  bp->p.perceptron_history_len = c.perceptron_history_len;
+  if (!predictor_alloc(&bp->p)) {
+    predictor_free(&bp->p);
+    free(bp);
+    *err = BP_ENOMEM;
+    return NULL;
+  }
+
+  *err = BP_OK;
+  return bp;
+}
+
+void
+bp_destroy(bp_predictor *bp)
+{
+  if (bp == NULL) {
+    return;
+  }
+  predictor_free(&bp->p);
+  free(bp);
+}
+
+void
+bp_get_config(const bp_predictor *bp, bp_config *cfg)
+{
+  *cfg = bp->config;
+}
+
+int
+bp_predict(bp_predictor *bp, uint32_t pc)
+{
+  uint8_t prediction = predictor_predict(&bp->p, pc);
+
+  bp->pending = 1;
+  bp->pending_pc = pc;
+  bp->pending_prediction = prediction;
+  return prediction;
+}
+
+int16_t
+bp_confidence(bp_predictor *bp, uint32_t pc)
+{
+  return predictor_confidence(&bp->p, pc);
+}
+
+void
+bp_train(bp_predictor *bp, uint32_t pc, int outcome)
+{
+  if (bp->pending && bp->pending_pc == pc) {
+    bp->stats.branches++;
+    if (bp->pending_prediction != (outcome != 0)) {
+      bp->stats.mispredictions++;
+    }
+  }
+  bp->pending = 0;
+  predictor_train(&bp->p, pc, outcome != 0);
+}
+
+size_t
+bp_run(bp_predictor *bp, const bp_branch *branches, size_t n,
+       uint8_t *predictions, int16_t *confidence)
+{
+  predictor_t *p = &bp->p;
+  size_t mispredictions = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    uint32_t pc = branches[i].pc;
+    uint8_t outcome = branches[i].outcome != 0;
+    if (confidence) {
+      confidence[i] = predictor_confidence(p, pc);
+    }
+    uint8_t prediction = predictor_predict(p, pc);
+    if (predictions) {
+      predictions[i] = prediction;
+    }
+    mispredictions += (prediction != outcome);
+    predictor_train(p, pc, outcome);
+  }
+
+  bp->pending = 0;
+  bp->stats.branches += n;
+  bp->stats.mispredictions += mispredictions;
+  return mispredictions;
+}
+
+size_t
+bp_run_arrays(bp_predictor *bp, const uint32_t *pcs, const uint8_t *outcomes,
+              size_t n, uint8_t *predictions, int16_t *confidence)
+{
+  predictor_t *p = &bp->p;
+  size_t mispredictions = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    uint32_t pc = pcs[i];
+    uint8_t outcome = outcomes[i] != 0;
+    if (confidence) {
+      confidence[i] = predictor_confidence(p, pc);
+    }
+    uint8_t prediction = predictor_predict(p, pc);
+    if (predictions) {
+      predictions[i] = prediction;
+    }
+    mispredictions += (prediction != outcome);
+    predictor_train(p, pc, outcome);
+  }
+
+  bp->pending = 0;
+  bp->stats.branches += n;
+  bp->stats.mispredictions += mispredictions;
+  return mispredictions;
+}
+
+void
+bp_get_stats(const bp_predictor *bp, bp_stats *stats)
+{
+  *stats = bp->stats;
+}
+
+void
+bp_reset_stats(bp_predictor *bp)
+{
+  memset(&bp->stats, 0, sizeof(bp_stats));
+  bp->pending = 0;
+}
+
+size_t
+bp_serialize(const bp_predictor *bp, void *buf, size_t cap)
+{
+  struct table t[4];
+  int n = get_tables(bp, t);
+  size_t size = sizeof(struct state_header);
+  for (int i = 0; i < n; i++) {
+    size += t[i].bytes;
+  }
+  if (buf == NULL || cap < size) {
+    return size;
+  }
+
+  struct state_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, STATE_MAGIC, 4);
+  h.abi_version = BP_ABI_VERSION;
+  h.byte_order = STATE_BYTE_ORDER;
+  h.config = bp->config;
+  h.ghistory = bp->p.ghistory;
+  h.stats = bp->stats;
+
+  char *out = buf;
+  memcpy(out, &h, sizeof(h));
+  out += sizeof(h);
+  for (int i = 0; i < n; i++) {
+    memcpy(out, t[i].data, t[i].bytes);
+    out += t[i].bytes;
+  }
+  return size;
+}
+
+// Check saved tables 'in', laid out as by get_tables, before they
+// replace the live ones: counters are 2-bit, local histories index
+// the local predictor and weights stay within the training threshold
+//
+// Returns True if the tables are safe to use
+//
+static int
+valid_tables(const bp_predictor *bp, const struct table t[4], int n,
+             const char *in)
+{
+  const predictor_t *p = &bp->p;
+
+  for (int i = 0; i < n; i++) {
+    const unsigned char *b = (const unsigned char *)in;
+    if (p->bpType == CUSTOM) {
+      for (size_t k = 0; k < t[i].bytes; k += sizeof(int16_t)) {
+        int16_t w;
+        memcpy(&w, b + k, sizeof(w));
+        if (abs(w) > p->perceptron_train_threshold) {
+          return 0;
+        }
+      }
+    } else if (t[i].data == p->tournament_lht) {
+      for (size_t k = 0; k < t[i].bytes; k += sizeof(uint16_t)) {
+        uint16_t h;
+        memcpy(&h, b + k, sizeof(h));
+        if (h >= (1u << p->tournament_lht_len)) {
+          return 0;
+        }
+      }
+    } else {
+      for (size_t k = 0; k < t[i].bytes; k++) {
+        if (b[k] > ST) {
+          return 0;
+        }
+      }
+    }
+    in += t[i].bytes;
+  }
+  return 1;
+}
+
+int
+bp_deserialize(bp_predictor *bp, const void *buf, size_t len)
+{
+  struct state_header h;
+  struct table t[4];
+
+  if (buf == NULL || len < sizeof(h)) {
+    return BP_EINVAL;
+  }
+  memcpy(&h, buf, sizeof(h));
+  if (memcmp(h.magic, STATE_MAGIC, 4) != 0) {
+    return BP_EINVAL;
+  }
+  if (h.abi_version != BP_ABI_VERSION || h.byte_order != STATE_BYTE_ORDER ||
+      memcmp(&h.config, &bp->config, sizeof(bp_config)) != 0) {
+    return BP_EVERSION;
+  }
+
+  int n = get_tables(bp, t);
+  size_t size = sizeof(h);
+  for (int i = 0; i < n; i++) {
+    size += t[i].bytes;
+  }
+  if (len != size) {
+    return BP_EINVAL;
+  }
+
+  const char *in = (const char *)buf + sizeof(h);
+  if (!valid_tables(bp, t, n, in)) {
+    return BP_EINVAL;
+  }
+  for (int i = 0; i < n; i++) {
+    memcpy(t[i].data, in, t[i].bytes);
+    in += t[i].bytes;
+  }
+  bp->p.ghistory = h.ghistory;
+  bp->stats = h.stats;
+  bp->pending = 0;
+  return BP_OK;
+}
@@ -0,0 +1,139 @@
+//========================================================//
+//  libpredictor.h                                        //
+//  Public C interface of libpredictor                    //
+//                                                        //
+//  Lets a simulator run the branch predictors in its own //
+//  process.  Every predictor is a separate instance, so  //
+//  instances may be used from different threads.        //
+//========================================================//
+
+#ifndef LIBPREDICTOR_H
+#define LIBPREDICTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) && defined(BP_BUILDING_LIBRARY)
+#define BP_API __attribute__((visibility("default")))
+#else
+#define BP_API
+#endif
+
+// Version of this interface.  Incremented whenever a function or
+// structure below changes incompatibly.  bp_abi_version() returns
+// the version the library was built with.
+#define BP_ABI_VERSION  1
+
+// Predictor types
+#define BP_STATIC      0
+#define BP_GSHARE      1
+#define BP_TOURNAMENT  2
+#define BP_CUSTOM      3   // perceptron
+
+#define BP_NOTTAKEN    0
+#define BP_TAKEN       1
+
+// Error codes
+#define BP_OK          0
+#define BP_EINVAL     -1   // bad argument or configuration
+#define BP_ENOMEM     -2   // out of memory
+#define BP_EVERSION   -3   // state was saved by an incompatible predictor
+
+typedef struct bp_predictor bp_predictor;
+
+// Predictor configuration.  Fill it with bp_config_init and then
+// change the fields of interest.  'size' lets newer libraries accept
+// configurations from callers built against an older, shorter struct.
+//
+typedef struct bp_config {
+  uint32_t size;                    // sizeof(bp_config)
+  int32_t type;                     // BP_STATIC ... BP_CUSTOM
+  int32_t ghistory_bits;            // gshare history and index bits
+  int32_t tournament_gp_len;        // global history bits
+  int32_t tournament_choice_len;    // choice table index bits
+  int32_t tournament_lht_len;       // local history table index bits
+  int32_t tournament_lp_len;        // local predictor index bits
+  int32_t perceptron_count;         // number of perceptrons
+  int32_t perceptron_history_len;   // history bits per perceptron
+} bp_config;
+
+// One dynamic branch
+typedef struct bp_branch {
+  uint32_t pc;
+  uint8_t outcome;                  // BP_TAKEN or BP_NOTTAKEN
+} bp_branch;
+
+typedef struct bp_stats {
+  uint64_t branches;
+  uint64_t mispredictions;
+} bp_stats;
+
+BP_API int bp_abi_version(void);
+
+// Fill 'cfg' with the default configuration of predictor 'type'
+//
+BP_API void bp_config_init(bp_config *cfg, int type);
+
+// Create a predictor.  Returns NULL and stores an error code in
+// '*err' (if not NULL) on failure.
+//
+BP_API bp_predictor *bp_create(const bp_config *cfg, int *err);
+BP_API void bp_destroy(bp_predictor *bp);
+
+// Copy the configuration the predictor was created with
+//
+BP_API void bp_get_config(const bp_predictor *bp, bp_config *cfg);
+
+// Predict the branch at 'pc'.  The prediction is remembered, and the
+// next bp_train for the same 'pc' counts it in the statistics.
+//
+BP_API int bp_predict(bp_predictor *bp, uint32_t pc);
+
+// Confidence of the prediction for 'pc': the perceptron output, or
+// the state of the 2-bit counter that makes the prediction
+//
+BP_API int16_t bp_confidence(bp_predictor *bp, uint32_t pc);
+
+// Train with the outcome of the branch at 'pc'
+//
+BP_API void bp_train(bp_predictor *bp, uint32_t pc, int outcome);
+
+// Predict and then train each of the 'n' branches in order, reading
+// them in place from the caller's array.  'predictions' and
+// 'confidence' may be NULL, otherwise they receive one entry per
+// branch.  Returns the number of mispredictions.
+//
+BP_API size_t bp_run(bp_predictor *bp, const bp_branch *branches, size_t n,
+                     uint8_t *predictions, int16_t *confidence);
+
+// As bp_run, for branches held in separate pc and outcome arrays
+//
+BP_API size_t bp_run_arrays(bp_predictor *bp, const uint32_t *pcs,
+                            const uint8_t *outcomes, size_t n,
+                            uint8_t *predictions, int16_t *confidence);
+
+BP_API void bp_get_stats(const bp_predictor *bp, bp_stats *stats);
+BP_API void bp_reset_stats(bp_predictor *bp);
+
+// Save the complete predictor state (tables, history and statistics)
+// to 'buf'.  Returns the number of bytes needed; nothing is written
+// when 'cap' is smaller than that.  The state is in host byte order.
+//
+BP_API size_t bp_serialize(const bp_predictor *bp, void *buf, size_t cap);
+
+// Restore state saved by bp_serialize into a predictor created with
+// the same configuration.  Returns BP_OK or an error code; state with
+// out of range table entries is refused with BP_EINVAL, and the
+// predictor is then left unchanged.
+//
+BP_API int bp_deserialize(bp_predictor *bp, const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,11 +8,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "predictor.h"
-
-FILE *stream;
-char *buf = NULL;
-size_t len = 0;
+#include "libpredictor.h"
+#include "trace.h"
+#include "batch.h"
+#include "predout.h"
+
+// Branches handed to the predictor library per call
+#define BATCH_SIZE  4096
+
+static int bpType;
+static int verbose;
+static bp_predictor *predictor;
+static trace_t *trace;
+static predout_t *predout = NULL;
+static char *predout_path = NULL;
+static int predout_format = PREDOUT_TEXT;
+static int predout_conf = 0;
+static char *trace_path = NULL;
+static char *batch_spec = NULL;
+static int nthreads = 0;
 
 // Print out the Usage information to stderr
 //
@@ -20,10 +34,21 @@ void
 usage()
 {
   fprintf(stderr,"Usage: predictor <options> [<trace>]\n");
+  fprintf(stderr,"       predictor <options> trace.bz2\n");
+  fprintf(stderr,"       predictor <options> --traces <dir>|<trace>,<trace>,...\n");
   fprintf(stderr,"       bunzip -kc trace.bz2 | predictor <options>\n");
   fprintf(stderr," Options:\n");
   fprintf(stderr," --help       Print this message\n");
   fprintf(stderr," --verbose    Print predictions on stdout\n");
+  fprintf(stderr," --verbose:<text|bits>[+conf]\n"
+                 "              Print predictions as text or packed bits, optionally\n"
+                 "              with the confidence (perceptron y or counter state)\n");
+  fprintf(stderr," --predout:<file> Write predictions to <file> instead of stdout\n");
+  fprintf(stderr," --threads:<n> Threads for .bz2 decompression (default: all cores,\n"
+                 "               shared between the traces with --traces)\n");
+  fprintf(stderr," --traces <dir|file,...>\n"
+                 "              Run many traces concurrently and print a summary\n"
+                 "              (no --verbose or --predout)\n");
   fprintf(stderr," --<type>     Branch prediction scheme:\n");
   fprintf(stderr,"    static\n"
                  "    gshare:<# ghistory>\n"
@@ -41,15 +66,34 @@ int
 handle_option(char *arg)
 {
   if (!strcmp(arg,"--static")) {
-    bpType = STATIC;
+    bpType = BP_STATIC;
   } else if (!strncmp(arg,"--gshare",8)) {
-    bpType = GSHARE;
+    bpType = BP_GSHARE;
   } else if (!strncmp(arg,"--tournament",12)) {
-    bpType = TOURNAMENT;
+    bpType = BP_TOURNAMENT;
   } else if (!strncmp(arg,"--custom",8)) {
-    bpType = CUSTOM;
+    bpType = BP_CUSTOM;
   } else if (!strcmp(arg,"--verbose")) {
     verbose = 1;
+  } else if (!strncmp(arg,"--verbose:",10)) {
+    char *mode = arg + 10;
+    char *plus = strchr(mode, '+');
+    if (plus != NULL && strcmp(plus, "+conf")) {
+      return 0;
+    }
+    if (!strncmp(mode, "text", 4) && (mode[4] == '\0' || mode[4] == '+')) {
+      predout_format = PREDOUT_TEXT;
+    } else if (!strncmp(mode, "bits", 4) && (mode[4] == '\0' || mode[4] == '+')) {
+      predout_format = PREDOUT_BITS;
+    } else {
+      return 0;
+    }
+    predout_conf = (plus != NULL);
+    verbose = 1;
+  } else if (!strncmp(arg,"--predout:",10)) {
+    predout_path = arg + 10;
+  } else if (!strncmp(arg,"--threads:",10)) {
+    nthreads = atoi(arg + 10);
   } else {
     return 0;
   }
@@ -57,31 +101,30 @@ handle_option(char *arg)
   return 1;
 }
 
-// Reads a line from the input stream and extracts the
-// PC and Outcome of a branch
+// Reads up to 'n' branches from the input stream
 //
-// Returns True if Successful 
+// Returns the number of branches read, 0 at the end of the trace
 //
-int
-read_branch(uint32_t *pc, uint8_t *outcome)
+size_t
+read_branches(bp_branch *branches, size_t n)
 {
-  if (getline(&buf, &len, stream) == -1) {
-    return 0;
+  static uint32_t pc = 0;
+  static uint8_t outcome = BP_NOTTAKEN;
+  size_t i = 0;
+
+  while (i < n && trace_read_branch(trace, &pc, &outcome)) {
+    branches[i].pc = pc;
+    branches[i].outcome = outcome;
+    i++;
   }
-
-  uint32_t tmp;
-  sscanf(buf,"0x%x %d\n",pc,&tmp);
-  *outcome = tmp;
-
-  return 1;
+  return i;
 }
 
 int
 main(int argc, char *argv[])
 {
   // Set defaults
-  stream = stdin;
-  bpType = STATIC;
+  bpType = BP_STATIC;
   verbose = 0;
 
   // Process cmdline Arguments
@@ -89,6 +132,8 @@ main(int argc, char *argv[])
     if (!strcmp(argv[i],"--help")) {
       usage();
       exit(0);
+    } else if (!strcmp(argv[i],"--traces") && i + 1 < argc) {
+      batch_spec = argv[++i];
     } else if (!strncmp(argv[i],"--",2)) {
       if (!handle_option(argv[i])) {
         printf("Unrecognized option %s\n", argv[i]);
@@ -97,44 +142,93 @@ main(int argc, char *argv[])
       }
     } else {
       // Use as input file
-      stream = fopen(argv[i], "r");
+      trace_path = argv[i];
     }
   }
 
-  // Initialize the predictor
-  init_predictor();
-
-  uint32_t num_branches = 0;
-  uint32_t mispredictions = 0;
-  uint32_t pc = 0;
-  uint8_t outcome = NOTTAKEN;
+  // Run a whole set of traces, one predictor per trace
+  bp_config config;
+  bp_config_init(&config, bpType);
+  if (batch_spec != NULL) {
+    if (verbose != 0 || predout_path != NULL) {
+      fprintf(stderr,"--verbose and --predout cannot be used with --traces\n");
+      exit(1);
+    }
+    return run_batch(batch_spec, &config, nthreads);
+  }
 
-  // Reach each branch from the trace
-  while (read_branch(&pc, &outcome)) {
-    num_branches++;
+  // Open the trace, .bz2 files are decompressed in parallel
+  trace = trace_open(trace_path, nthreads, 0);
+  if (trace == NULL) {
+    fprintf(stderr,"Unable to open trace %s\n", trace_path);
+    exit(1);
+  }
 
-    // Make a prediction and compare with actual outcome
-    uint8_t prediction = make_prediction(pc);
-    if (prediction != outcome) {
-      mispredictions++;
+  // Open the prediction stream
+  if (verbose != 0) {
+    predout = predout_open(predout_path, predout_format, predout_conf);
+    if (predout == NULL) {
+      fprintf(stderr,"Unable to open prediction output %s\n", predout_path);
+      exit(1);
     }
+  }
+
+  // Initialize the predictor
+  int err;
+  predictor = bp_create(&config, &err);
+  if (predictor == NULL) {
+    fprintf(stderr,"Unable to create predictor (error %d)\n", err);
+    exit(1);
+  }
+
+  static bp_branch branches[BATCH_SIZE];
+  static uint8_t predictions[BATCH_SIZE];
+  static int16_t confidence[BATCH_SIZE];
+  size_t n;
+
+  // Reach each branch from the trace, predicting and training
+  // a batch at a time
+  while ((n = read_branches(branches, BATCH_SIZE)) > 0) {
+    bp_run(predictor, branches, n, verbose ? predictions : NULL,
+           predout_conf ? confidence : NULL);
     if (verbose != 0) {
-      printf ("%d\n", prediction);
+      for (size_t i = 0; i < n; i++) {
+        predout_put(predout, predictions[i], predout_conf ? confidence[i] : 0);
+      }
     }
+  }
 
-    // Train the predictor
-    train_predictor(pc, outcome);
+  // The statistics are still printed, but the run fails
+  int status = 0;
+  if (predout != NULL && !predout_close(predout)) {
+    fprintf(stderr,"Error: failed to write predictions\n");
+    status = 1;
   }
 
-  // Print out the mispredict statistics
-  printf("Branches:        %10d\n", num_branches);
-  printf("Incorrect:       %10d\n", mispredictions);
+  if (trace_error(trace)) {
+    fprintf(stderr,"Error: trace is truncated or corrupt\n");
+    status = 1;
+  }
+
+  // Print out the mispredict statistics, on stderr when stdout
+  // carries the binary prediction stream
+  FILE *stats_out = stdout;
+  if (verbose != 0 && predout_format == PREDOUT_BITS &&
+      (predout_path == NULL || !strcmp(predout_path, "-"))) {
+    stats_out = stderr;
+  }
+  bp_stats stats;
+  bp_get_stats(predictor, &stats);
+  uint32_t num_branches = stats.branches;
+  uint32_t mispredictions = stats.mispredictions;
+  fprintf(stats_out, "Branches:        %10d\n", num_branches);
+  fprintf(stats_out, "Incorrect:       %10d\n", mispredictions);
   float mispredict_rate = 100*((float)mispredictions / (float)num_branches);
-  printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+  fprintf(stats_out, "Misprediction Rate: %7.3f\n", mispredict_rate);
 
   // Cleanup
-  fclose(stream);
-  free(buf);
+  bp_destroy(predictor);
+  trace_close(trace);
 
-  return 0;
+  return status;
 }
@@ -7,6 +7,7 @@
 //========================================================//
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 #include <stdbool.h>
 #include "predictor.h"
@@ -37,11 +38,9 @@ int verbose;
 //------------------------------------//
 
 //
+// Default sizes, copied into each predictor_t by predictor_init
 //
-//gshare predictor
-uint8_t *bht_gshare;
-uint64_t ghistory;
-
+//gshare predictor uses ghistoryBits above
 
 //tournament predictor
 int tournament_gp_len = 11;
@@ -53,19 +52,15 @@ int tournament_lp_len = 10;
 Tournament Predictor Memory Usage = (2^11)*2 + (2^11)*2 + (2^10)*2 + (2^10)*10 + 64 = 20480 + 64
 */
 
-uint8_t *tournament_bht_gp;
-uint8_t *tournament_bht_lp;
-uint16_t *tournament_lht;
-uint8_t *tournament_ct;
-
 int num_perceptrons = 85;
 int perceptron_history_len = 23;
-int perceptron_train_threshold;
-int16_t *perceptron_table;
 /*
 Perceptron Predictor Memory Usage = 85*24*16 + 64 = 32640 + 64
 */
 
+// Instance behind init_predictor/make_prediction/train_predictor
+static predictor_t default_predictor;
+
 
 
 //------------------------------------//
@@ -76,26 +71,26 @@ Perceptron Predictor Memory Usage = 85*24*16 + 64 = 32640 + 64
 //
 
 //gshare functions
-void init_gshare() {
- int bht_entries = 1 << ghistoryBits;
-  bht_gshare = (uint8_t*)malloc(bht_entries * sizeof(uint8_t));
+void init_gshare(predictor_t *p) {
+ int bht_entries = 1 << p->ghistoryBits;
+  p->bht_gshare = (uint8_t*)malloc(bht_entries * sizeof(uint8_t));
   int i = 0;
   for(i = 0; i< bht_entries; i++){
-    bht_gshare[i] = WN;
+    p->bht_gshare[i] = WN;
   }
-  ghistory = 0;
+  p->ghistory = 0;
 }
 
 
 
 uint8_t 
-gshare_predict(uint32_t pc) {
+gshare_predict(predictor_t *p, uint32_t pc) {
   //get lower ghistoryBits of pc
-  uint32_t bht_entries = 1 << ghistoryBits;
+  uint32_t bht_entries = 1 << p->ghistoryBits;
   uint32_t pc_lower_bits = pc & (bht_entries-1);
-  uint32_t ghistory_lower_bits = ghistory & (bht_entries -1);
+  uint32_t ghistory_lower_bits = p->ghistory & (bht_entries -1);
   uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
-  switch(bht_gshare[index]){
+  switch(p->bht_gshare[index]){
     case WN:
       return NOTTAKEN;
     case SN:
@@ -111,87 +106,87 @@ gshare_predict(uint32_t pc) {
 }
 
 void
-train_gshare(uint32_t pc, uint8_t outcome) {
+train_gshare(predictor_t *p, uint32_t pc, uint8_t outcome) {
   //get lower ghistoryBits of pc
-  uint32_t bht_entries = 1 << ghistoryBits;
+  uint32_t bht_entries = 1 << p->ghistoryBits;
   uint32_t pc_lower_bits = pc & (bht_entries-1);
-  uint32_t ghistory_lower_bits = ghistory & (bht_entries -1);
+  uint32_t ghistory_lower_bits = p->ghistory & (bht_entries -1);
   uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
 
   //Update state of entry in bht based on outcome
-  switch(bht_gshare[index]){
+  switch(p->bht_gshare[index]){
     case WN:
-      bht_gshare[index] = (outcome==TAKEN)?WT:SN;
+      p->bht_gshare[index] = (outcome==TAKEN)?WT:SN;
       break;
     case SN:
-      bht_gshare[index] = (outcome==TAKEN)?WN:SN;
+      p->bht_gshare[index] = (outcome==TAKEN)?WN:SN;
       break;
     case WT:
-      bht_gshare[index] = (outcome==TAKEN)?ST:WN;
+      p->bht_gshare[index] = (outcome==TAKEN)?ST:WN;
       break;
     case ST:
-      bht_gshare[index] = (outcome==TAKEN)?ST:WT;
+      p->bht_gshare[index] = (outcome==TAKEN)?ST:WT;
       break;
     default:
       printf("Warning: Undefined state of entry in GSHARE BHT!\n");
   }
 
   //Update history register
-  ghistory = ((ghistory << 1) | outcome); 
+  p->ghistory = ((p->ghistory << 1) | outcome); 
 }
 
 void
-cleanup_gshare() {
-  free(bht_gshare);
+cleanup_gshare(predictor_t *p) {
+  free(p->bht_gshare);
 }
 
 ////////Tournament Predictor////////////
 
-void init_tournament(){
-  int bht_gp_entries = 1 << tournament_gp_len;
-  tournament_bht_gp = (uint8_t*)malloc(bht_gp_entries * sizeof(uint8_t));
+void init_tournament(predictor_t *p){
+  int bht_gp_entries = 1 << p->tournament_gp_len;
+  p->tournament_bht_gp = (uint8_t*)malloc(bht_gp_entries * sizeof(uint8_t));
   int i = 0;
   for(i = 0; i< bht_gp_entries; i++){
-    tournament_bht_gp[i] = WN;
+    p->tournament_bht_gp[i] = WN;
     //printf("Tournament BHT GP %d : %d \n",i,tournament_bht_gp[i]);
   }
-  ghistory = 0;
+  p->ghistory = 0;
 
-  int ct_entries = 1 << tournament_choice_len;
-  tournament_ct = (uint8_t*)malloc(ct_entries * sizeof(uint8_t));
+  int ct_entries = 1 << p->tournament_choice_len;
+  p->tournament_ct = (uint8_t*)malloc(ct_entries * sizeof(uint8_t));
   for(i = 0; i< ct_entries; i++){
-    tournament_ct[i] = WT;
+    p->tournament_ct[i] = WT;
     //printf("Tournament Choice Table %d : %d \n",i,tournament_ct[i]);
   }
 
-  int lht_entries = 1 << tournament_lht_len;
-  tournament_lht = (uint16_t*)malloc(lht_entries * sizeof(uint16_t));
+  int lht_entries = 1 << p->tournament_lht_len;
+  p->tournament_lht = (uint16_t*)malloc(lht_entries * sizeof(uint16_t));
   for(i = 0; i< lht_entries; i++){
-    tournament_lht[i] = 0;
+    p->tournament_lht[i] = 0;
     //printf("Tournament LHT %d : %d \n",i,tournament_lht[i]);
   }
   
-  int bht_lp_entries = 1 << tournament_lp_len;
-  tournament_bht_lp = (uint8_t*)malloc(bht_lp_entries * sizeof(uint8_t));
+  int bht_lp_entries = 1 << p->tournament_lp_len;
+  p->tournament_bht_lp = (uint8_t*)malloc(bht_lp_entries * sizeof(uint8_t));
   for(i = 0; i< bht_lp_entries; i++){
-    tournament_bht_lp[i] = WN;
+    p->tournament_bht_lp[i] = WN;
     //printf("Tournament BHT LP %d : %d \n",i,tournament_bht_lp[i]);
   }
 
 }
 
-uint8_t tournament_predict(uint32_t pc){
-  uint32_t bht_gp_entries = 1 << tournament_gp_len;
-  uint32_t index_ght_ct = ghistory & (bht_gp_entries -1);
+uint8_t tournament_predict(predictor_t *p, uint32_t pc){
+  uint32_t bht_gp_entries = 1 << p->tournament_gp_len;
+  uint32_t index_ght_ct = p->ghistory & (bht_gp_entries -1);
 
 
-  uint32_t lht_entries = 1 << tournament_lht_len;
+  uint32_t lht_entries = 1 << p->tournament_lht_len;
 
   uint32_t lp_pc_lower_bits = pc & (lht_entries-1);
-  uint16_t index_pht = tournament_lht[lp_pc_lower_bits];
+  uint16_t index_pht = p->tournament_lht[lp_pc_lower_bits];
 
   uint8_t lp_predict;
-  switch(tournament_bht_lp[index_pht]){
+  switch(p->tournament_bht_lp[index_pht]){
     case WN:
       lp_predict = NOTTAKEN;
       break;
@@ -205,12 +200,12 @@ uint8_t tournament_predict(uint32_t pc){
       lp_predict = TAKEN;
       break;
     default:
-      printf("Warning: PREDICT : Undefined state of entry in Tournament Local BHT! %d %d \n",index_pht,tournament_bht_lp[index_pht]);
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Local BHT! %d %d \n",index_pht,p->tournament_bht_lp[index_pht]);
       lp_predict = NOTTAKEN;
   }
   
   uint8_t gp_predict;
-  switch(tournament_bht_gp[index_ght_ct]){
+  switch(p->tournament_bht_gp[index_ght_ct]){
     case WN:
       gp_predict = NOTTAKEN;
       break;
@@ -224,7 +219,7 @@ uint8_t tournament_predict(uint32_t pc){
       gp_predict = TAKEN;
       break;
     default:
-      printf("Warning: PREDICT : Undefined state of entry in Tournament Globql BHT! %d %d \n",index_ght_ct,tournament_bht_gp[index_ght_ct]);
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Globql BHT! %d %d \n",index_ght_ct,p->tournament_bht_gp[index_ght_ct]);
       gp_predict = NOTTAKEN;
   }
 
@@ -232,7 +227,7 @@ uint8_t tournament_predict(uint32_t pc){
     return gp_predict;
   else{
     uint8_t ct_predict;
-    switch(tournament_ct[index_ght_ct]){
+    switch(p->tournament_ct[index_ght_ct]){
     case WN:
       ct_predict = 0;
       break;
@@ -246,7 +241,7 @@ uint8_t tournament_predict(uint32_t pc){
       ct_predict = 1;
       break;
     default:
-      printf("Warning: PREDICT : Undefined state of entry in Choice Table! %d %d \n",index_ght_ct,tournament_ct[index_ght_ct]);
+      printf("Warning: PREDICT : Undefined state of entry in Choice Table! %d %d \n",index_ght_ct,p->tournament_ct[index_ght_ct]);
       ct_predict = 1;
     }
   
@@ -259,18 +254,18 @@ uint8_t tournament_predict(uint32_t pc){
 
 }
 
-void train_tournament(uint32_t pc, uint8_t outcome){
-  uint32_t bht_gp_entries = 1 << tournament_gp_len;
-  uint32_t index_ght_ct = ghistory & (bht_gp_entries -1);
+void train_tournament(predictor_t *p, uint32_t pc, uint8_t outcome){
+  uint32_t bht_gp_entries = 1 << p->tournament_gp_len;
+  uint32_t index_ght_ct = p->ghistory & (bht_gp_entries -1);
 
 
-  uint32_t lht_entries = 1 << tournament_lht_len;
+  uint32_t lht_entries = 1 << p->tournament_lht_len;
 
   uint32_t lp_pc_lower_bits = pc & (lht_entries-1);
-  uint16_t index_pht = tournament_lht[lp_pc_lower_bits];
+  uint16_t index_pht = p->tournament_lht[lp_pc_lower_bits];
 
   uint8_t lp_predict;
-  switch(tournament_bht_lp[index_pht]){
+  switch(p->tournament_bht_lp[index_pht]){
     case WN:
       lp_predict = NOTTAKEN;
       break;
@@ -284,12 +279,12 @@ void train_tournament(uint32_t pc, uint8_t outcome){
       lp_predict = TAKEN;
       break;
     default:
-      printf("Warning: PREDICT : Undefined state of entry in Tournament Local BHT! %d %d \n",index_pht,tournament_bht_lp[index_pht]);
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Local BHT! %d %d \n",index_pht,p->tournament_bht_lp[index_pht]);
       lp_predict = NOTTAKEN;
   }
   
   uint8_t gp_predict;
-  switch(tournament_bht_gp[index_ght_ct]){
+  switch(p->tournament_bht_gp[index_ght_ct]){
     case WN:
       gp_predict = NOTTAKEN;
       break;
@@ -303,7 +298,7 @@ void train_tournament(uint32_t pc, uint8_t outcome){
       gp_predict = TAKEN;
       break;
     default:
-      printf("Warning: PREDICT : Undefined state of entry in Tournament Globql BHT! %d %d \n",index_ght_ct,tournament_bht_gp[index_ght_ct]);
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Globql BHT! %d %d \n",index_ght_ct,p->tournament_bht_gp[index_ght_ct]);
       gp_predict = NOTTAKEN;
   }
 
@@ -313,7 +308,7 @@ void train_tournament(uint32_t pc, uint8_t outcome){
   if(gp_predict == lp_predict)
     bp_result = gp_predict;
   else{
-    switch(tournament_ct[index_ght_ct]){
+    switch(p->tournament_ct[index_ght_ct]){
     case WN:
       ct_predict = 0;
       break;
@@ -327,7 +322,7 @@ void train_tournament(uint32_t pc, uint8_t outcome){
       ct_predict = 1;
       break;
     default:
-      printf("Warning: PREDICT : Undefined state of entry in Choice Table! %d %d \n",index_ght_ct,tournament_ct[index_ght_ct]);
+      printf("Warning: PREDICT : Undefined state of entry in Choice Table! %d %d \n",index_ght_ct,p->tournament_ct[index_ght_ct]);
       ct_predict = 1;
     }
   
@@ -339,36 +334,36 @@ void train_tournament(uint32_t pc, uint8_t outcome){
   
   bool lp_correct = false;
   bool gp_correct = false; 
-  if((tournament_bht_lp[index_pht] == WN || tournament_bht_lp[index_pht] == SN) && (outcome == NOTTAKEN))
+  if((p->tournament_bht_lp[index_pht] == WN || p->tournament_bht_lp[index_pht] == SN) && (outcome == NOTTAKEN))
     lp_correct = true;
-  else if((tournament_bht_lp[index_pht] == WT || tournament_bht_lp[index_pht] == ST) && (outcome == TAKEN))
+  else if((p->tournament_bht_lp[index_pht] == WT || p->tournament_bht_lp[index_pht] == ST) && (outcome == TAKEN))
     lp_correct = true;
 
-  if((tournament_bht_gp[index_ght_ct] == WN || tournament_bht_gp[index_ght_ct] == SN) && (outcome == NOTTAKEN))
+  if((p->tournament_bht_gp[index_ght_ct] == WN || p->tournament_bht_gp[index_ght_ct] == SN) && (outcome == NOTTAKEN))
     lp_correct = true;
-  else if((tournament_bht_gp[index_ght_ct] == WT || tournament_bht_gp[index_ght_ct] == ST) && (outcome == TAKEN))
+  else if((p->tournament_bht_gp[index_ght_ct] == WT || p->tournament_bht_gp[index_ght_ct] == ST) && (outcome == TAKEN))
     lp_correct = true;
 
     if(ct_predict == 0 && !lp_correct && gp_correct || ct_predict == 1 && lp_correct && !gp_correct){
-      uint8_t ct_prediction = tournament_ct[index_ght_ct];
+      uint8_t ct_prediction = p->tournament_ct[index_ght_ct];
       switch((gp_predict << 1)| lp_predict){
       case WN:
         if(lp_correct)
           if(ct_prediction != SN)
-            tournament_ct[index_ght_ct] -= 1;
+            p->tournament_ct[index_ght_ct] -= 1;
         else
           if(ct_prediction != ST)
-            tournament_ct[index_ght_ct] += 1; 
+            p->tournament_ct[index_ght_ct] += 1; 
         break;
       case SN:
         break;
       case WT:
         if(lp_correct)
           if(ct_prediction != SN)
-            tournament_ct[index_ght_ct] -= 1;
+            p->tournament_ct[index_ght_ct] -= 1;
         else
           if(ct_prediction != ST)
-            tournament_ct[index_ght_ct] += 1; 
+            p->tournament_ct[index_ght_ct] += 1; 
         break;
       case ST:
         break;
@@ -377,47 +372,54 @@ void train_tournament(uint32_t pc, uint8_t outcome){
       }
     }
 
-      switch(tournament_bht_lp[index_pht]){
+      switch(p->tournament_bht_lp[index_pht]){
       case WN:
-        tournament_bht_lp[index_pht] = (outcome==TAKEN)?WT:SN;
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?WT:SN;
         break;
       case SN:
-        tournament_bht_lp[index_pht] = (outcome==TAKEN)?WN:SN;
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?WN:SN;
         break;
       case WT:
-        tournament_bht_lp[index_pht] = (outcome==TAKEN)?ST:WN;
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?ST:WN;
         break;
       case ST:
-        tournament_bht_lp[index_pht] = (outcome==TAKEN)?ST:WT;
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?ST:WT;
         break;
       default:
         printf("Warning: Undefined state of entry in LP table!\n");
       }
 
-      switch(tournament_bht_gp[index_ght_ct]){
+      switch(p->tournament_bht_gp[index_ght_ct]){
       case WN:
-        tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?WT:SN;
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?WT:SN;
         break;
       case SN:
-        tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?WN:SN;
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?WN:SN;
         break;
       case WT:
-        tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?ST:WN;
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?ST:WN;
         break;
       case ST:
-        tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?ST:WT;
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?ST:WT;
         break;
       default:
         printf("Warning: Undefined state of entry in GP table!\n");
       }
 
-  ghistory = ((ghistory << 1) | outcome) & (bht_gp_entries - 1); 
-  tournament_lht[lp_pc_lower_bits] = ((tournament_lht[lp_pc_lower_bits] << 1) | outcome) & (lht_entries-1);
+  p->ghistory = ((p->ghistory << 1) | outcome) & (bht_gp_entries - 1); 
+  p->tournament_lht[lp_pc_lower_bits] = ((p->tournament_lht[lp_pc_lower_bits] << 1) | outcome) & (lht_entries-1);
 
   //printf("AFTER TRAIN : %x %d %d LP %d %d %d ; GP %d %d %d; LHT %d %x; GH %lu \n",pc,outcome,bp_result,lp_correct,index_pht,tournament_bht_lp[index_pht],gp_correct,index_ght_ct,tournament_bht_gp[index_ght_ct],lp_pc_lower_bits,tournament_ct[lp_pc_lower_bits],ghistory);
 
 }
 
+void cleanup_tournament(predictor_t *p){
+  free(p->tournament_bht_gp);
+  free(p->tournament_bht_lp);
+  free(p->tournament_lht);
+  free(p->tournament_ct);
+}
+
 ///////////////////////////////////////
 /*
 int num_perceptrons = 170;
@@ -428,43 +430,48 @@ int8_t *perceptron_table;
 
 /////////Perceptron Predictor//////////
 
-void init_perceptron(){
-  int perceptron_table_entries = num_perceptrons*(perceptron_history_len+1);
-  perceptron_table = (int16_t*)malloc(perceptron_table_entries*sizeof(int16_t));
+void init_perceptron(predictor_t *p){
+  int perceptron_table_entries = p->num_perceptrons*(p->perceptron_history_len+1);
+  p->perceptron_table = (int16_t*)malloc(perceptron_table_entries*sizeof(int16_t));
   int i=0;
   for(i=0; i < perceptron_table_entries; i=i+1){
-    perceptron_table[i] = 0;
+    p->perceptron_table[i] = 0;
   }
-  perceptron_train_threshold = (int)(1.93*perceptron_history_len + 14);
-  ghistory = 0;
+  p->perceptron_train_threshold = (int)(1.93*p->perceptron_history_len + 14);
+  p->ghistory = 0;
 }
 
-uint8_t perceptron_predict(uint32_t pc){
-  uint32_t table_index = (pc % num_perceptrons) * (perceptron_history_len+1);
-  int16_t y = perceptron_table[table_index];
-  uint64_t curr_ghistory = ghistory;
-  for(int i=1; i<=perceptron_history_len; i=i+1){
+int16_t perceptron_output(predictor_t *p, uint32_t pc){
+  uint32_t table_index = (pc % p->num_perceptrons) * (p->perceptron_history_len+1);
+  int16_t y = p->perceptron_table[table_index];
+  uint64_t curr_ghistory = p->ghistory;
+  for(int i=1; i<=p->perceptron_history_len; i=i+1){
     if(curr_ghistory&1)
-      y += perceptron_table[table_index+i];
+      y += p->perceptron_table[table_index+i];
     else
-      y -= perceptron_table[table_index+i];
+      y -= p->perceptron_table[table_index+i];
     curr_ghistory = curr_ghistory >> 1;
   }
+  return y;
+}
+
+uint8_t perceptron_predict(predictor_t *p, uint32_t pc){
+  int16_t y = perceptron_output(p, pc);
   if(y<0)
     return NOTTAKEN;
   else
     return TAKEN;
 }
 
-void train_perceptron(uint32_t pc, uint8_t outcome){
-  uint32_t table_index = (pc % num_perceptrons) * (perceptron_history_len+1);
-  int16_t y = perceptron_table[table_index];
-  uint64_t curr_ghistory = ghistory;
-  for(int i=1; i<=perceptron_history_len; i=i+1){
+void train_perceptron(predictor_t *p, uint32_t pc, uint8_t outcome){
+  uint32_t table_index = (pc % p->num_perceptrons) * (p->perceptron_history_len+1);
+  int16_t y = p->perceptron_table[table_index];
+  uint64_t curr_ghistory = p->ghistory;
+  for(int i=1; i<=p->perceptron_history_len; i=i+1){
     if(curr_ghistory&1)
-      y += perceptron_table[table_index+i];
+      y += p->perceptron_table[table_index+i];
     else
-      y -= perceptron_table[table_index+i];
+      y -= p->perceptron_table[table_index+i];
     curr_ghistory = curr_ghistory >> 1;
   }
   uint8_t bp_result;
@@ -476,24 +483,24 @@ void train_perceptron(uint32_t pc, uint8_t outcome){
   bool mispredict = true;
   if(bp_result == outcome)
     mispredict = false;
-  if(mispredict || abs(y) <= perceptron_train_threshold){
+  if(mispredict || abs(y) <= p->perceptron_train_threshold){
     if(outcome == 1){
-      if(abs(perceptron_table[table_index]+1) < perceptron_train_threshold)
-        perceptron_table[table_index] ++;
+      if(abs(p->perceptron_table[table_index]+1) < p->perceptron_train_threshold)
+        p->perceptron_table[table_index] ++;
     }
     else{
-      if(abs(perceptron_table[table_index]-1) < perceptron_train_threshold)
-        perceptron_table[table_index] --;
+      if(abs(p->perceptron_table[table_index]-1) < p->perceptron_train_threshold)
+        p->perceptron_table[table_index] --;
     }
-    uint64_t curr_ghistory = ghistory;
-    for(int i=1; i<=perceptron_history_len; i=i+1){
+    uint64_t curr_ghistory = p->ghistory;
+    for(int i=1; i<=p->perceptron_history_len; i=i+1){
       if(outcome == (curr_ghistory&1)){
-        if(abs(perceptron_table[table_index+i]+1) < perceptron_train_threshold)
-          perceptron_table[table_index+i] += 1;
+        if(abs(p->perceptron_table[table_index+i]+1) < p->perceptron_train_threshold)
+          p->perceptron_table[table_index+i] += 1;
       }
       else {
-        if(abs(perceptron_table[table_index+i]-1) < perceptron_train_threshold)
-          perceptron_table[table_index+i] -= 1;
+        if(abs(p->perceptron_table[table_index+i]-1) < p->perceptron_train_threshold)
+          p->perceptron_table[table_index+i] -= 1;
       }
       curr_ghistory = curr_ghistory >> 1;
     }
@@ -501,7 +508,11 @@ void train_perceptron(uint32_t pc, uint8_t outcome){
   //if(abs(y)>511)
   //  printf("Output threshold crossed! %x %d %d \n",pc,y,perceptron_train_threshold);
   
-  ghistory = ((ghistory << 1) | outcome);
+  p->ghistory = ((p->ghistory << 1) | outcome);
+}
+
+void cleanup_perceptron(predictor_t *p){
+  free(p->perceptron_table);
 }
 
 ///////////////////////////////////////
@@ -511,43 +522,74 @@ void train_perceptron(uint32_t pc, uint8_t outcome){
 
 
 
+// Set up instance 'p' as a predictor of type 'type' with the default
+// table sizes, without allocating any tables
+//
 void
-init_predictor()
+predictor_defaults(predictor_t *p, int type)
+{
+  memset(p, 0, sizeof(predictor_t));
+  p->bpType = type;
+  p->ghistoryBits = ghistoryBits;
+  p->tournament_gp_len = tournament_gp_len;
+  p->tournament_choice_len = tournament_choice_len;
+  p->tournament_lht_len = tournament_lht_len;
+  p->tournament_lp_len = tournament_lp_len;
+  p->num_perceptrons = num_perceptrons;
+  p->perceptron_history_len = perceptron_history_len;
+}
+
+// Allocate and reset the tables of instance 'p' for its current
+// type and table sizes
+//
+// Returns True if Successful
+//
+int
+predictor_alloc(predictor_t *p)
 {
-  switch (bpType) {
+  switch (p->bpType) {
     case STATIC:
     case GSHARE:
-      init_gshare();
-      break;
+      init_gshare(p);
+      return p->bht_gshare != NULL;
     case TOURNAMENT:
-      init_tournament();
-      break;
+      init_tournament(p);
+      return p->tournament_bht_gp && p->tournament_bht_lp &&
+             p->tournament_lht && p->tournament_ct;
     case CUSTOM:
-      init_perceptron();
+      init_perceptron(p);
+      return p->perceptron_table != NULL;
     default:
       break;
   }
-  
+  return 1;
 }
 
-// Make a prediction for conditional branch instruction at PC 'pc'
-// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
-// indicates a prediction of not taken
+// Initialize predictor instance 'p' as a predictor of type 'type'
+//
+void
+predictor_init(predictor_t *p, int type)
+{
+  predictor_defaults(p, type);
+  predictor_alloc(p);
+}
+
+// Make a prediction with instance 'p' for the branch at PC 'pc'
 //
 uint8_t
-make_prediction(uint32_t pc)
+predictor_predict(predictor_t *p, uint32_t pc)
 {
 
   // Make a prediction based on the bpType
-  switch (bpType) {
+  switch (p->bpType) {
     case STATIC:
       return TAKEN;
     case GSHARE:
-      return gshare_predict(pc);
+      return gshare_predict(p, pc);
     case TOURNAMENT:
-      return tournament_predict(pc);
+      return tournament_predict(p, pc);
     case CUSTOM:
-      return perceptron_predict(pc);
+      return perceptron_predict(p, pc);
     default:
       break;
   }
@@ -556,26 +598,103 @@ make_prediction(uint32_t pc)
   return NOTTAKEN;
 }
 
-// Train the predictor the last executed branch at PC 'pc' and with
-// outcome 'outcome' (true indicates that the branch was taken, false
-// indicates that the branch was not taken)
+// Train instance 'p' with the outcome of the branch at PC 'pc'
 //
-
 void
-train_predictor(uint32_t pc, uint8_t outcome)
+predictor_train(predictor_t *p, uint32_t pc, uint8_t outcome)
 {
 
-  switch (bpType) {
+  switch (p->bpType) {
     case STATIC:
     case GSHARE:
-      return train_gshare(pc, outcome);
+      return train_gshare(p, pc, outcome);
     case TOURNAMENT:
-      return train_tournament(pc, outcome);
+      return train_tournament(p, pc, outcome);
     case CUSTOM:
-      return train_perceptron(pc, outcome);
+      return train_perceptron(p, pc, outcome);
     default:
       break;
   }
   
 
 }
+
+// Confidence behind the prediction of instance 'p' for the branch at
+// PC 'pc': the perceptron output y, or the state of the 2-bit counter
+// that supplied the prediction
+//
+int16_t
+predictor_confidence(predictor_t *p, uint32_t pc)
+{
+  uint32_t entries, index, lht_entries;
+  uint8_t lp_state, gp_state;
+
+  switch (p->bpType) {
+    case GSHARE:
+      entries = 1 << p->ghistoryBits;
+      index = (pc & (entries-1)) ^ (p->ghistory & (entries-1));
+      return p->bht_gshare[index];
+    case TOURNAMENT:
+      entries = 1 << p->tournament_gp_len;
+      index = p->ghistory & (entries-1);
+      lht_entries = 1 << p->tournament_lht_len;
+      lp_state = p->tournament_bht_lp[p->tournament_lht[pc & (lht_entries-1)]];
+      gp_state = p->tournament_bht_gp[index];
+      if ((lp_state >= WT) != (gp_state >= WT) && p->tournament_ct[index] < WT)
+        return lp_state;
+      return gp_state;
+    case CUSTOM:
+      return perceptron_output(p, pc);
+    default:
+      break;
+  }
+
+  return 0;
+}
+
+// Release the tables of instance 'p'
+//
+void
+predictor_free(predictor_t *p)
+{
+  switch (p->bpType) {
+    case STATIC:
+    case GSHARE:
+      cleanup_gshare(p);
+      break;
+    case TOURNAMENT:
+      cleanup_tournament(p);
+      break;
+    case CUSTOM:
+      cleanup_perceptron(p);
+    default:
+      break;
+  }
+}
+
+void
+init_predictor()
+{
+  predictor_init(&default_predictor, bpType);
+}
+
+// Make a prediction for conditional branch instruction at PC 'pc'
+// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
+// indicates a prediction of not taken
+//
+uint8_t
+make_prediction(uint32_t pc)
+{
+  return predictor_predict(&default_predictor, pc);
+}
+
+// Train the predictor the last executed branch at PC 'pc' and with
+// outcome 'outcome' (true indicates that the branch was taken, false
+// indicates that the branch was not taken)
+//
+
+void
+train_predictor(uint32_t pc, uint8_t outcome)
+{
+  predictor_train(&default_predictor, pc, outcome);
+}
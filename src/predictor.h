@@ -47,6 +47,38 @@ extern int pcIndexBits;  // Number of bits used for PC index
 extern int bpType;       // Branch Prediction Type
 extern int verbose;
 
+//------------------------------------//
+//      Predictor Data Structures     //
+//------------------------------------//
+
+// Complete state of one predictor, so that several predictors
+// can run side by side
+//
+typedef struct predictor {
+  int bpType;
+  uint64_t ghistory;
+
+  //gshare predictor
+  int ghistoryBits;
+  uint8_t *bht_gshare;
+
+  //tournament predictor
+  int tournament_gp_len;
+  int tournament_choice_len;
+  int tournament_lht_len;
+  int tournament_lp_len;
+  uint8_t *tournament_bht_gp;
+  uint8_t *tournament_bht_lp;
+  uint16_t *tournament_lht;
+  uint8_t *tournament_ct;
+
+  //perceptron predictor
+  int num_perceptrons;
+  int perceptron_history_len;
+  int perceptron_train_threshold;
+  int16_t *perceptron_table;
+} predictor_t;
+
 //------------------------------------//
 //    Predictor Function Prototypes   //
 //------------------------------------//
@@ -67,4 +99,24 @@ uint8_t make_prediction(uint32_t pc);
 //
 void train_predictor(uint32_t pc, uint8_t outcome);
 
+// Instance versions of the functions above.  predictor_init takes its
+// table sizes from the configuration variables at the time of the call.
+//
+void predictor_init(predictor_t *p, int bpType);
+uint8_t predictor_predict(predictor_t *p, uint32_t pc);
+void predictor_train(predictor_t *p, uint32_t pc, uint8_t outcome);
+void predictor_free(predictor_t *p);
+
+// predictor_init in two steps, so that the table sizes set by
+// predictor_defaults can be changed before predictor_alloc.
+// predictor_alloc returns False if a table could not be allocated.
+//
+void predictor_defaults(predictor_t *p, int bpType);
+int predictor_alloc(predictor_t *p);
+
+// Confidence behind the prediction for PC 'pc': perceptron output y,
+// or the 2-bit counter state the prediction came from (0 for static)
+//
+int16_t predictor_confidence(predictor_t *p, uint32_t pc);
+
 #endif
@@ -0,0 +1,536 @@
+//========================================================//
+//  predictor_ref.c                                       //
+//  Reference implementation of the Branch Predictors     //
+//                                                        //
+//  A frozen copy of the predictors in predictor.c as     //
+//  they produced log_run_tournament_predictor and        //
+//  log_run_perceptron_predictor.  Do not optimize or     //
+//  "fix" anything here: check.c compares every faster    //
+//  engine against this code, branch by branch.           //
+//========================================================//
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "predictor.h"
+#include "predictor_ref.h"
+
+//------------------------------------//
+//        Predictor Functions         //
+//------------------------------------//
+
+//gshare functions
+static void ref_init_gshare(predictor_t *p) {
+ int bht_entries = 1 << p->ghistoryBits;
+  p->bht_gshare = (uint8_t*)malloc(bht_entries * sizeof(uint8_t));
+  int i = 0;
+  for(i = 0; i< bht_entries; i++){
+    p->bht_gshare[i] = WN;
+  }
+  p->ghistory = 0;
+}
+
+
+
+static uint8_t
+ref_gshare_predict(predictor_t *p, uint32_t pc) {
+  //get lower ghistoryBits of pc
+  uint32_t bht_entries = 1 << p->ghistoryBits;
+  uint32_t pc_lower_bits = pc & (bht_entries-1);
+  uint32_t ghistory_lower_bits = p->ghistory & (bht_entries -1);
+  uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
+  switch(p->bht_gshare[index]){
+    case WN:
+      return NOTTAKEN;
+    case SN:
+      return NOTTAKEN;
+    case WT:
+      return TAKEN;
+    case ST:
+      return TAKEN;
+    default:
+      printf("Warning: Undefined state of entry in GSHARE BHT!\n");
+      return NOTTAKEN;
+  }
+}
+
+static void
+ref_train_gshare(predictor_t *p, uint32_t pc, uint8_t outcome) {
+  //get lower ghistoryBits of pc
+  uint32_t bht_entries = 1 << p->ghistoryBits;
+  uint32_t pc_lower_bits = pc & (bht_entries-1);
+  uint32_t ghistory_lower_bits = p->ghistory & (bht_entries -1);
+  uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
+
+  //Update state of entry in bht based on outcome
+  switch(p->bht_gshare[index]){
+    case WN:
+      p->bht_gshare[index] = (outcome==TAKEN)?WT:SN;
+      break;
+    case SN:
+      p->bht_gshare[index] = (outcome==TAKEN)?WN:SN;
+      break;
+    case WT:
+      p->bht_gshare[index] = (outcome==TAKEN)?ST:WN;
+      break;
+    case ST:
+      p->bht_gshare[index] = (outcome==TAKEN)?ST:WT;
+      break;
+    default:
+      printf("Warning: Undefined state of entry in GSHARE BHT!\n");
+  }
+
+  //Update history register
+  p->ghistory = ((p->ghistory << 1) | outcome); 
+}
+
+static void
+ref_cleanup_gshare(predictor_t *p) {
+  free(p->bht_gshare);
+}
+
+////////Tournament Predictor////////////
+
+static void ref_init_tournament(predictor_t *p){
+  int bht_gp_entries = 1 << p->tournament_gp_len;
+  p->tournament_bht_gp = (uint8_t*)malloc(bht_gp_entries * sizeof(uint8_t));
+  int i = 0;
+  for(i = 0; i< bht_gp_entries; i++){
+    p->tournament_bht_gp[i] = WN;
+    //printf("Tournament BHT GP %d : %d \n",i,tournament_bht_gp[i]);
+  }
+  p->ghistory = 0;
+
+  int ct_entries = 1 << p->tournament_choice_len;
+  p->tournament_ct = (uint8_t*)malloc(ct_entries * sizeof(uint8_t));
+  for(i = 0; i< ct_entries; i++){
+    p->tournament_ct[i] = WT;
+    //printf("Tournament Choice Table %d : %d \n",i,tournament_ct[i]);
+  }
+
+  int lht_entries = 1 << p->tournament_lht_len;
+  p->tournament_lht = (uint16_t*)malloc(lht_entries * sizeof(uint16_t));
+  for(i = 0; i< lht_entries; i++){
+    p->tournament_lht[i] = 0;
+    //printf("Tournament LHT %d : %d \n",i,tournament_lht[i]);
+  }
+  
+  int bht_lp_entries = 1 << p->tournament_lp_len;
+  p->tournament_bht_lp = (uint8_t*)malloc(bht_lp_entries * sizeof(uint8_t));
+  for(i = 0; i< bht_lp_entries; i++){
+    p->tournament_bht_lp[i] = WN;
+    //printf("Tournament BHT LP %d : %d \n",i,tournament_bht_lp[i]);
+  }
+
+}
+
+static uint8_t ref_tournament_predict(predictor_t *p, uint32_t pc){
+  uint32_t bht_gp_entries = 1 << p->tournament_gp_len;
+  uint32_t index_ght_ct = p->ghistory & (bht_gp_entries -1);
+
+
+  uint32_t lht_entries = 1 << p->tournament_lht_len;
+
+  uint32_t lp_pc_lower_bits = pc & (lht_entries-1);
+  uint16_t index_pht = p->tournament_lht[lp_pc_lower_bits];
+
+  uint8_t lp_predict;
+  switch(p->tournament_bht_lp[index_pht]){
+    case WN:
+      lp_predict = NOTTAKEN;
+      break;
+    case SN:
+      lp_predict = NOTTAKEN;
+      break;
+    case WT:
+      lp_predict = TAKEN;
+      break;
+    case ST:
+      lp_predict = TAKEN;
+      break;
+    default:
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Local BHT! %d %d \n",index_pht,p->tournament_bht_lp[index_pht]);
+      lp_predict = NOTTAKEN;
+  }
+  
+  uint8_t gp_predict;
+  switch(p->tournament_bht_gp[index_ght_ct]){
+    case WN:
+      gp_predict = NOTTAKEN;
+      break;
+    case SN:
+      gp_predict = NOTTAKEN;
+      break;
+    case WT:
+      gp_predict = TAKEN;
+      break;
+    case ST:
+      gp_predict = TAKEN;
+      break;
+    default:
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Globql BHT! %d %d \n",index_ght_ct,p->tournament_bht_gp[index_ght_ct]);
+      gp_predict = NOTTAKEN;
+  }
+
+  if(gp_predict == lp_predict)
+    return gp_predict;
+  else{
+    uint8_t ct_predict;
+    switch(p->tournament_ct[index_ght_ct]){
+    case WN:
+      ct_predict = 0;
+      break;
+    case SN:
+      ct_predict = 0;
+      break;
+    case WT:
+      ct_predict = 1;
+      break;
+    case ST:
+      ct_predict = 1;
+      break;
+    default:
+      printf("Warning: PREDICT : Undefined state of entry in Choice Table! %d %d \n",index_ght_ct,p->tournament_ct[index_ght_ct]);
+      ct_predict = 1;
+    }
+  
+    if(ct_predict == 0)
+      return lp_predict;
+    else
+      return gp_predict;
+  }
+
+
+}
+
+static void ref_train_tournament(predictor_t *p, uint32_t pc, uint8_t outcome){
+  uint32_t bht_gp_entries = 1 << p->tournament_gp_len;
+  uint32_t index_ght_ct = p->ghistory & (bht_gp_entries -1);
+
+
+  uint32_t lht_entries = 1 << p->tournament_lht_len;
+
+  uint32_t lp_pc_lower_bits = pc & (lht_entries-1);
+  uint16_t index_pht = p->tournament_lht[lp_pc_lower_bits];
+
+  uint8_t lp_predict;
+  switch(p->tournament_bht_lp[index_pht]){
+    case WN:
+      lp_predict = NOTTAKEN;
+      break;
+    case SN:
+      lp_predict = NOTTAKEN;
+      break;
+    case WT:
+      lp_predict = TAKEN;
+      break;
+    case ST:
+      lp_predict = TAKEN;
+      break;
+    default:
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Local BHT! %d %d \n",index_pht,p->tournament_bht_lp[index_pht]);
+      lp_predict = NOTTAKEN;
+  }
+  
+  uint8_t gp_predict;
+  switch(p->tournament_bht_gp[index_ght_ct]){
+    case WN:
+      gp_predict = NOTTAKEN;
+      break;
+    case SN:
+      gp_predict = NOTTAKEN;
+      break;
+    case WT:
+      gp_predict = TAKEN;
+      break;
+    case ST:
+      gp_predict = TAKEN;
+      break;
+    default:
+      printf("Warning: PREDICT : Undefined state of entry in Tournament Globql BHT! %d %d \n",index_ght_ct,p->tournament_bht_gp[index_ght_ct]);
+      gp_predict = NOTTAKEN;
+  }
+
+  uint8_t ct_predict;
+  uint8_t bp_result;
+
+  if(gp_predict == lp_predict)
+    bp_result = gp_predict;
+  else{
+    switch(p->tournament_ct[index_ght_ct]){
+    case WN:
+      ct_predict = 0;
+      break;
+    case SN:
+      ct_predict = 0;
+      break;
+    case WT:
+      ct_predict = 1;
+      break;
+    case ST:
+      ct_predict = 1;
+      break;
+    default:
+      printf("Warning: PREDICT : Undefined state of entry in Choice Table! %d %d \n",index_ght_ct,p->tournament_ct[index_ght_ct]);
+      ct_predict = 1;
+    }
+  
+    if(ct_predict == 0)
+      bp_result = lp_predict;
+    else
+      bp_result = gp_predict;
+  }
+  
+  bool lp_correct = false;
+  bool gp_correct = false; 
+  if((p->tournament_bht_lp[index_pht] == WN || p->tournament_bht_lp[index_pht] == SN) && (outcome == NOTTAKEN))
+    lp_correct = true;
+  else if((p->tournament_bht_lp[index_pht] == WT || p->tournament_bht_lp[index_pht] == ST) && (outcome == TAKEN))
+    lp_correct = true;
+
+  if((p->tournament_bht_gp[index_ght_ct] == WN || p->tournament_bht_gp[index_ght_ct] == SN) && (outcome == NOTTAKEN))
+    lp_correct = true;
+  else if((p->tournament_bht_gp[index_ght_ct] == WT || p->tournament_bht_gp[index_ght_ct] == ST) && (outcome == TAKEN))
+    lp_correct = true;
+
+    if(ct_predict == 0 && !lp_correct && gp_correct || ct_predict == 1 && lp_correct && !gp_correct){
+      uint8_t ct_prediction = p->tournament_ct[index_ght_ct];
+      switch((gp_predict << 1)| lp_predict){
+      case WN:
+        if(lp_correct)
+          if(ct_prediction != SN)
+            p->tournament_ct[index_ght_ct] -= 1;
+        else
+          if(ct_prediction != ST)
+            p->tournament_ct[index_ght_ct] += 1; 
+        break;
+      case SN:
+        break;
+      case WT:
+        if(lp_correct)
+          if(ct_prediction != SN)
+            p->tournament_ct[index_ght_ct] -= 1;
+        else
+          if(ct_prediction != ST)
+            p->tournament_ct[index_ght_ct] += 1; 
+        break;
+      case ST:
+        break;
+      default:
+        printf("Warning: Undefined state of entry in Choice table!\n");
+      }
+    }
+
+      switch(p->tournament_bht_lp[index_pht]){
+      case WN:
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?WT:SN;
+        break;
+      case SN:
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?WN:SN;
+        break;
+      case WT:
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?ST:WN;
+        break;
+      case ST:
+        p->tournament_bht_lp[index_pht] = (outcome==TAKEN)?ST:WT;
+        break;
+      default:
+        printf("Warning: Undefined state of entry in LP table!\n");
+      }
+
+      switch(p->tournament_bht_gp[index_ght_ct]){
+      case WN:
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?WT:SN;
+        break;
+      case SN:
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?WN:SN;
+        break;
+      case WT:
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?ST:WN;
+        break;
+      case ST:
+        p->tournament_bht_gp[index_ght_ct] = (outcome==TAKEN)?ST:WT;
+        break;
+      default:
+        printf("Warning: Undefined state of entry in GP table!\n");
+      }
+
+  p->ghistory = ((p->ghistory << 1) | outcome) & (bht_gp_entries - 1); 
+  p->tournament_lht[lp_pc_lower_bits] = ((p->tournament_lht[lp_pc_lower_bits] << 1) | outcome) & (lht_entries-1);
+
+  //printf("AFTER TRAIN : %x %d %d LP %d %d %d ; GP %d %d %d; LHT %d %x; GH %lu \n",pc,outcome,bp_result,lp_correct,index_pht,tournament_bht_lp[index_pht],gp_correct,index_ght_ct,tournament_bht_gp[index_ght_ct],lp_pc_lower_bits,tournament_ct[lp_pc_lower_bits],ghistory);
+
+}
+
+static void ref_cleanup_tournament(predictor_t *p){
+  free(p->tournament_bht_gp);
+  free(p->tournament_bht_lp);
+  free(p->tournament_lht);
+  free(p->tournament_ct);
+}
+
+///////////////////////////////////////
+/*
+int num_perceptrons = 170;
+int perceptron_history_len = 23;
+int perceptron_train_threshold;
+int8_t *perceptron_table;
+*/
+
+/////////Perceptron Predictor//////////
+
+static void ref_init_perceptron(predictor_t *p){
+  int perceptron_table_entries = p->num_perceptrons*(p->perceptron_history_len+1);
+  p->perceptron_table = (int16_t*)malloc(perceptron_table_entries*sizeof(int16_t));
+  int i=0;
+  for(i=0; i < perceptron_table_entries; i=i+1){
+    p->perceptron_table[i] = 0;
+  }
+  p->perceptron_train_threshold = (int)(1.93*p->perceptron_history_len + 14);
+  p->ghistory = 0;
+}
+
+static uint8_t ref_perceptron_predict(predictor_t *p, uint32_t pc){
+  uint32_t table_index = (pc % p->num_perceptrons) * (p->perceptron_history_len+1);
+  int16_t y = p->perceptron_table[table_index];
+  uint64_t curr_ghistory = p->ghistory;
+  for(int i=1; i<=p->perceptron_history_len; i=i+1){
+    if(curr_ghistory&1)
+      y += p->perceptron_table[table_index+i];
+    else
+      y -= p->perceptron_table[table_index+i];
+    curr_ghistory = curr_ghistory >> 1;
+  }
+  if(y<0)
+    return NOTTAKEN;
+  else
+    return TAKEN;
+}
+
+static void ref_train_perceptron(predictor_t *p, uint32_t pc, uint8_t outcome){
+  uint32_t table_index = (pc % p->num_perceptrons) * (p->perceptron_history_len+1);
+  int16_t y = p->perceptron_table[table_index];
+  uint64_t curr_ghistory = p->ghistory;
+  for(int i=1; i<=p->perceptron_history_len; i=i+1){
+    if(curr_ghistory&1)
+      y += p->perceptron_table[table_index+i];
+    else
+      y -= p->perceptron_table[table_index+i];
+    curr_ghistory = curr_ghistory >> 1;
+  }
+  uint8_t bp_result;
+  if(y<0)
+    bp_result = NOTTAKEN;
+  else
+    bp_result = TAKEN;
+  
+  bool mispredict = true;
+  if(bp_result == outcome)
+    mispredict = false;
+  if(mispredict || abs(y) <= p->perceptron_train_threshold){
+    if(outcome == 1){
+      if(abs(p->perceptron_table[table_index]+1) < p->perceptron_train_threshold)
+        p->perceptron_table[table_index] ++;
+    }
+    else{
+      if(abs(p->perceptron_table[table_index]-1) < p->perceptron_train_threshold)
+        p->perceptron_table[table_index] --;
+    }
+    uint64_t curr_ghistory = p->ghistory;
+    for(int i=1; i<=p->perceptron_history_len; i=i+1){
+      if(outcome == (curr_ghistory&1)){
+        if(abs(p->perceptron_table[table_index+i]+1) < p->perceptron_train_threshold)
+          p->perceptron_table[table_index+i] += 1;
+      }
+      else {
+        if(abs(p->perceptron_table[table_index+i]-1) < p->perceptron_train_threshold)
+          p->perceptron_table[table_index+i] -= 1;
+      }
+      curr_ghistory = curr_ghistory >> 1;
+    }
+  }
+  //if(abs(y)>511)
+  //  printf("Output threshold crossed! %x %d %d \n",pc,y,perceptron_train_threshold);
+  
+  p->ghistory = ((p->ghistory << 1) | outcome);
+}
+
+static void ref_cleanup_perceptron(predictor_t *p){
+  free(p->perceptron_table);
+}
+
+///////////////////////////////////////
+
+int
+ref_predictor_alloc(predictor_t *p)
+{
+  switch (p->bpType) {
+    case STATIC:
+    case GSHARE:
+      ref_init_gshare(p);
+      return p->bht_gshare != NULL;
+    case TOURNAMENT:
+      ref_init_tournament(p);
+      return p->tournament_bht_gp && p->tournament_bht_lp &&
+             p->tournament_lht && p->tournament_ct;
+    case CUSTOM:
+      ref_init_perceptron(p);
+      return p->perceptron_table != NULL;
+    default:
+      break;
+  }
+  return 1;
+}
+
+uint8_t
+ref_predictor_predict(predictor_t *p, uint32_t pc)
+{
+  switch (p->bpType) {
+    case STATIC:
+      return TAKEN;
+    case GSHARE:
+      return ref_gshare_predict(p, pc);
+    case TOURNAMENT:
+      return ref_tournament_predict(p, pc);
+    case CUSTOM:
+      return ref_perceptron_predict(p, pc);
+    default:
+      break;
+  }
+
+  return NOTTAKEN;
+}
+
+void
+ref_predictor_train(predictor_t *p, uint32_t pc, uint8_t outcome)
+{
+  switch (p->bpType) {
+    case STATIC:
+    case GSHARE:
+      return ref_train_gshare(p, pc, outcome);
+    case TOURNAMENT:
+      return ref_train_tournament(p, pc, outcome);
+    case CUSTOM:
+      return ref_train_perceptron(p, pc, outcome);
+    default:
+      break;
+  }
+}
+
+void
+ref_predictor_free(predictor_t *p)
+{
+  switch (p->bpType) {
+    case STATIC:
+    case GSHARE:
+      ref_cleanup_gshare(p);
+      break;
+    case TOURNAMENT:
+      ref_cleanup_tournament(p);
+      break;
+    case CUSTOM:
+      ref_cleanup_perceptron(p);
+    default:
+      break;
+  }
+}
@@ -0,0 +1,22 @@
+//========================================================//
+//  predictor_ref.h                                       //
+//  Header file for the Reference Branch Predictors       //
+//                                                        //
+//  Same interface as predictor_alloc/predict/train/free  //
+//  in predictor.h, backed by the frozen reference code   //
+//========================================================//
+
+#ifndef PREDICTOR_REF_H
+#define PREDICTOR_REF_H
+
+#include "predictor.h"
+
+// Allocate the tables of 'p', which must have been set up with
+// predictor_defaults.  Returns False if a table could not be allocated.
+//
+int ref_predictor_alloc(predictor_t *p);
+uint8_t ref_predictor_predict(predictor_t *p, uint32_t pc);
+void ref_predictor_train(predictor_t *p, uint32_t pc, uint8_t outcome);
+void ref_predictor_free(predictor_t *p);
+
+#endif
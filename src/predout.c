@@ -0,0 +1,316 @@
+//========================================================//
+//  predout.c                                             //
+//  Source file for the Prediction Output Stream          //
+//                                                        //
+//  Predictions are collected in a large user-space       //
+//  buffer.  Each full buffer goes out with one writev,   //
+//  or, when the output is a regular file, is copied      //
+//  into a shared mapping of the file so no write system  //
+//  call is needed at all.  The file is only grown, with  //
+//  posix_fallocate, by what is about to be written.      //
+//========================================================//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "predout.h"
+
+#define TEXT_BUFFER  (1u << 20)
+#define MAP_WINDOW   ((off_t)64 << 20)
+
+struct predout {
+  int fd;
+  int close_fd;
+  int format;
+  int with_conf;
+  int error;
+
+  // Frame being filled
+  uint32_t count;
+  uint8_t *bits;
+  uint8_t *conf;           // int16 little endian
+  char *text;
+  size_t text_len;
+
+  // mmap sink
+  int use_mmap;
+  off_t file_pos;          // next byte to write
+  off_t file_end;          // end of the space reserved in the file
+  char *map;
+  off_t map_off;
+  size_t map_len;
+};
+
+//------------------------------------//
+//               Sinks                //
+//------------------------------------//
+
+// Make sure the mapping covers 'file_pos'.  The window may extend
+// past the end of the file; only reserved bytes are ever touched.
+//
+static int
+map_window(predout_t *o)
+{
+  if (o->map) {
+    munmap(o->map, o->map_len);
+    o->map = NULL;
+  }
+  o->map_off = o->file_pos & ~(MAP_WINDOW - 1);
+  o->map_len = MAP_WINDOW;
+  void *m = mmap(NULL, o->map_len, PROT_WRITE, MAP_SHARED, o->fd, o->map_off);
+  if (m == MAP_FAILED) {
+    return 0;
+  }
+  o->map = m;
+  return 1;
+}
+
+static int
+mmap_writev(predout_t *o, const struct iovec *iov, int n)
+{
+  // Reserve real blocks for the data first, so that a full disk or the
+  // file size limit is an error here instead of SIGBUS in memcpy, and
+  // the file is never extended beyond what is written
+  off_t end = o->file_pos;
+  for (int i = 0; i < n; i++) {
+    end += iov[i].iov_len;
+  }
+  if (end > o->file_end) {
+    if (posix_fallocate(o->fd, o->file_end, end - o->file_end) != 0) {
+      return 0;
+    }
+    o->file_end = end;
+  }
+
+  for (int i = 0; i < n; i++) {
+    const char *src = iov[i].iov_base;
+    size_t len = iov[i].iov_len;
+    while (len > 0) {
+      if (!o->map || o->file_pos >= o->map_off + (off_t)o->map_len) {
+        if (!map_window(o)) {
+          return 0;
+        }
+      }
+      size_t room = o->map_off + o->map_len - o->file_pos;
+      size_t k = len < room ? len : room;
+      memcpy(o->map + (o->file_pos - o->map_off), src, k);
+      o->file_pos += k;
+      src += k;
+      len -= k;
+    }
+  }
+  return 1;
+}
+
+static int
+fd_writev(predout_t *o, struct iovec *iov, int n)
+{
+  while (n > 0) {
+    ssize_t w = writev(o->fd, iov, n);
+    if (w < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 0;
+    }
+    // Skip what was written, resume a partial write
+    while (n > 0 && (size_t)w >= iov->iov_len) {
+      w -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + w;
+      iov->iov_len -= w;
+    }
+  }
+  return 1;
+}
+
+static void
+emit(predout_t *o, struct iovec *iov, int n)
+{
+  if (o->error) {
+    return;
+  }
+  off_t start = o->file_pos;
+  if (o->use_mmap && mmap_writev(o, iov, n)) {
+    return;
+  }
+  if (o->use_mmap) {
+    // Mapping failed part way, drop the part of this frame already
+    // copied and carry on with plain writes from its start
+    o->use_mmap = 0;
+    o->file_pos = start;
+    if (o->map) {
+      munmap(o->map, o->map_len);
+      o->map = NULL;
+    }
+    o->error = ftruncate(o->fd, o->file_pos) != 0 ||
+               lseek(o->fd, o->file_pos, SEEK_SET) < 0;
+    emit(o, iov, n);
+    return;
+  }
+  if (!fd_writev(o, iov, n)) {
+    o->error = 1;
+  }
+}
+
+//------------------------------------//
+//              Flushing              //
+//------------------------------------//
+
+static void
+flush_frame(predout_t *o)
+{
+  if (o->format == PREDOUT_TEXT) {
+    if (o->text_len > 0) {
+      struct iovec iov = { o->text, o->text_len };
+      emit(o, &iov, 1);
+      o->text_len = 0;
+    }
+    return;
+  }
+
+  if (o->count == 0) {
+    return;
+  }
+  uint8_t hdr[4] = { o->count, o->count >> 8, o->count >> 16, o->count >> 24 };
+  struct iovec iov[3] = {
+    { hdr, sizeof(hdr) },
+    { o->bits, (o->count + 7) / 8 },
+    { o->conf, (size_t)o->count * 2 },
+  };
+  emit(o, iov, o->with_conf ? 3 : 2);
+  memset(o->bits, 0, PREDOUT_FRAME / 8);
+  o->count = 0;
+}
+
+//------------------------------------//
+//          Stream Interface          //
+//------------------------------------//
+
+predout_t *
+predout_open(const char *path, int format, int with_conf)
+{
+  predout_t *o = calloc(1, sizeof(predout_t));
+  if (!o) {
+    return NULL;
+  }
+  o->format = format;
+  o->with_conf = with_conf;
+
+  if (path == NULL || !strcmp(path, "-")) {
+    o->fd = STDOUT_FILENO;
+  } else {
+    o->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    o->close_fd = 1;
+    if (o->fd < 0) {
+      free(o);
+      return NULL;
+    }
+  }
+
+  // Write through a mapping when the output is a regular file
+  // that is not opened for appending
+  struct stat st;
+  int flags = fcntl(o->fd, F_GETFL);
+  if (fstat(o->fd, &st) == 0 && S_ISREG(st.st_mode) &&
+      flags >= 0 && (flags & O_ACCMODE) == O_RDWR && !(flags & O_APPEND)) {
+    o->file_pos = lseek(o->fd, 0, SEEK_CUR);
+    o->file_end = o->file_pos;
+    o->use_mmap = o->file_pos >= 0;
+  }
+
+  if (format == PREDOUT_TEXT) {
+    o->text = malloc(TEXT_BUFFER);
+  } else {
+    o->bits = calloc(PREDOUT_FRAME / 8, 1);
+    o->conf = malloc((size_t)PREDOUT_FRAME * 2);
+    uint8_t hdr[8] = { 'B', 'P', 'R', 'D', PREDOUT_VERSION,
+                       with_conf ? PREDOUT_CONF : 0, 0, 0 };
+    struct iovec iov = { hdr, sizeof(hdr) };
+    if (o->bits && o->conf) {
+      emit(o, &iov, 1);
+    }
+  }
+  if ((format == PREDOUT_TEXT && !o->text) ||
+      (format != PREDOUT_TEXT && (!o->bits || !o->conf))) {
+    predout_close(o);
+    return NULL;
+  }
+
+  return o;
+}
+
+void
+predout_put(predout_t *o, uint8_t prediction, int16_t conf)
+{
+  if (o->format == PREDOUT_TEXT) {
+    if (o->text_len + 16 > TEXT_BUFFER) {
+      flush_frame(o);
+    }
+    char *p = o->text + o->text_len;
+    *p++ = '0' + (prediction != 0);
+    if (o->with_conf) {
+      char digits[8];
+      int n = 0;
+      unsigned v = conf < 0 ? -(int)conf : conf;
+      *p++ = ' ';
+      if (conf < 0) {
+        *p++ = '-';
+      }
+      do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+      } while (v > 0);
+      while (n > 0) {
+        *p++ = digits[--n];
+      }
+    }
+    *p++ = '\n';
+    o->text_len = p - o->text;
+    return;
+  }
+
+  uint32_t i = o->count++;
+  o->bits[i >> 3] |= (prediction != 0) << (i & 7);
+  o->conf[2 * i] = (uint16_t)conf;
+  o->conf[2 * i + 1] = (uint16_t)conf >> 8;
+  if (o->count == PREDOUT_FRAME) {
+    flush_frame(o);
+  }
+}
+
+int
+predout_close(predout_t *o)
+{
+  if (o->text || o->bits) {
+    flush_frame(o);
+  }
+
+  // Trim the file to what was written and leave the offset there
+  if (o->use_mmap && o->map) {
+    munmap(o->map, o->map_len);
+    if (ftruncate(o->fd, o->file_pos) != 0 ||
+        lseek(o->fd, o->file_pos, SEEK_SET) < 0) {
+      o->error = 1;
+    }
+  }
+  if (o->close_fd) {
+    close(o->fd);
+  }
+
+  int ok = !o->error;
+  free(o->text);
+  free(o->bits);
+  free(o->conf);
+  free(o);
+  return ok;
+}
@@ -0,0 +1,51 @@
+//========================================================//
+//  predout.h                                             //
+//  Header file for the Prediction Output Stream          //
+//                                                        //
+//  Buffers the per-branch predictions of --verbose and   //
+//  writes them either as text or as packed bits          //
+//========================================================//
+
+#ifndef PREDOUT_H
+#define PREDOUT_H
+
+#include <stdint.h>
+
+// Output formats
+#define PREDOUT_TEXT  0   // "<prediction>\n" or "<prediction> <conf>\n"
+#define PREDOUT_BITS  1   // binary stream, see below
+
+// Binary stream layout, all integers little endian:
+//
+//   header  "BPRD", uint8 version (1), uint8 flags, 2 bytes zero
+//           flags bit 0 set when confidence values are present
+//   frames  uint32 count
+//           (count+7)/8 bytes of predictions, branch i of the frame
+//             in bit i%8 of byte i/8
+//           count int16 confidence values, if flagged
+//
+// Frames hold up to PREDOUT_FRAME branches; only the last may be shorter.
+#define PREDOUT_VERSION  1
+#define PREDOUT_CONF     0x1
+#define PREDOUT_FRAME    (1u << 20)
+
+typedef struct predout predout_t;
+
+// Open a prediction stream on 'path' (NULL or "-" is stdout).
+// Regular files are written through mmap, anything else with writev.
+//
+// Returns NULL if the output cannot be opened
+//
+predout_t *predout_open(const char *path, int format, int with_conf);
+
+// Append the prediction and confidence of one branch
+//
+void predout_put(predout_t *o, uint8_t prediction, int16_t conf);
+
+// Flush everything and close the stream (stdout is left open)
+//
+// Returns True if every write succeeded
+//
+int predout_close(predout_t *o);
+
+#endif
@@ -1,13 +1,2 @@
 make clean all 
-echo "fp_1"
-bunzip2 -kc ../traces/fp_1.bz2 | ./predictor --tournament
-echo "fp_2"
-bunzip2 -kc ../traces/fp_2.bz2 | ./predictor --tournament
-echo "int_1"
-bunzip2 -kc ../traces/int_1.bz2 | ./predictor --tournament
-echo "int_2"
-bunzip2 -kc ../traces/int_2.bz2 | ./predictor --tournament
-echo "mm_1"
-bunzip2 -kc ../traces/mm_1.bz2 | ./predictor --tournament
-echo "mm_2"
-bunzip2 -kc ../traces/mm_2.bz2 | ./predictor --tournament
\ No newline at end of file
+./predictor --tournament --traces ../traces/fp_1.bz2,../traces/fp_2.bz2,../traces/int_1.bz2,../traces/int_2.bz2,../traces/mm_1.bz2,../traces/mm_2.bz2
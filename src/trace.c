@@ -0,0 +1,844 @@
+//========================================================//
+//  trace.c                                               //
+//  Source file for the Trace Reader                      //
+//                                                        //
+//  bzip2 compresses its input in independent blocks,     //
+//  each introduced by a 48-bit magic number that is not  //
+//  byte aligned.  The reader locates those magics, wraps //
+//  every block into a standalone single-block stream and //
+//  decodes the blocks on a thread pool.  Decoded blocks  //
+//  are handed to the parser strictly in order, and no    //
+//  more than 'window' blocks are held ahead of it.       //
+//========================================================//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bzlib.h>
+#include "trace.h"
+
+#define BZ_BLOCK_MAGIC  0x314159265359ULL
+#define BZ_EOS_MAGIC    0x177245385090ULL
+#define BZ_MAGIC_MASK   0xFFFFFFFFFFFFULL
+#define BZ_LEVEL_BYTES  100000   // uncompressed bytes per block per level
+
+#define STDIO_CHUNK     (1u << 20)
+#define SERIAL_CHUNK    (1u << 20)
+
+// Where the parser gets its chunks from
+enum { SRC_STDIO, SRC_BZ2_PARALLEL, SRC_BZ2_SERIAL };
+
+// States of a decoded-block slot
+enum { SLOT_EMPTY, SLOT_BUSY, SLOT_READY, SLOT_FAILED };
+
+struct slot {
+  char *data;
+  size_t len;
+  int state;
+};
+
+struct trace {
+  int src;
+  int error;
+
+  // SRC_STDIO
+  FILE *fp;
+  char *iobuf;
+
+  // Compressed input, mapped read-only
+  const unsigned char *cdata;
+  size_t csize;
+
+  // Block table, as bit offsets into cdata
+  uint64_t *blk_start;
+  uint64_t *blk_end;
+  int nblocks;
+  int level;               // largest block size level of any stream
+
+  // SRC_BZ2_PARALLEL worker pool
+  pthread_t *workers;
+  int nworkers;
+  pthread_mutex_t lock;
+  pthread_cond_t work_cv;  // signalled when the window advances
+  pthread_cond_t done_cv;  // signalled when a block is decoded
+  struct slot *slots;
+  int window;
+  int next_block;          // next block to hand to a worker
+  int cur_block;           // block being parsed, or next to parse
+  int holding;             // parser owns the slot of cur_block
+  int stop;
+
+  // SRC_BZ2_SERIAL, used when a block fails to decode on its own
+  bz_stream bz;
+  int bz_live;
+  size_t bz_off;
+  size_t bz_skip;
+  char *serbuf;
+
+  // Chunk currently being parsed
+  const char *chunk;
+  size_t chunk_len;
+  size_t chunk_pos;
+  size_t delivered;        // bytes handed to the parser so far
+  int eof;
+  int started;             // format has been detected
+  int binary;              // binary records instead of text lines
+
+  // Partial line spanning two chunks
+  char *carry;
+  size_t carry_len;
+  size_t carry_cap;
+};
+
+//------------------------------------//
+//          Bit Manipulation          //
+//------------------------------------//
+
+static unsigned
+get_byte(const unsigned char *buf, size_t size, size_t i)
+{
+  return i < size ? buf[i] : 0;
+}
+
+// Read 'n' (<= 32) bits MSB first starting at bit 'pos'
+//
+static uint32_t
+get_bits(const unsigned char *buf, size_t size, uint64_t pos, int n)
+{
+  uint32_t v = 0;
+  for (int i = 0; i < n; i++, pos++) {
+    v = (v << 1) | ((get_byte(buf, size, pos >> 3) >> (7 - (pos & 7))) & 1);
+  }
+  return v;
+}
+
+// Write the low 'n' bits of 'v' MSB first at bit '*pos'
+//
+static void
+put_bits(unsigned char *buf, uint64_t *pos, uint64_t v, int n)
+{
+  for (int i = n - 1; i >= 0; i--, (*pos)++) {
+    if ((v >> i) & 1) {
+      buf[*pos >> 3] |= 0x80 >> (*pos & 7);
+    }
+  }
+}
+
+// Record the position of every block and end-of-stream magic
+//
+static int
+scan_blocks(trace_t *t)
+{
+  size_t cap = 64;
+  uint64_t *marks = malloc(cap * sizeof(uint64_t));
+  uint8_t *is_block = malloc(cap);
+  size_t nmarks = 0;
+  uint64_t w = 0;
+
+  if (!marks || !is_block) {
+    free(marks);
+    free(is_block);
+    return 0;
+  }
+
+  for (size_t i = 0; i < t->csize; i++) {
+    w = (w << 8) | t->cdata[i];
+    if (i < 5) {
+      continue;
+    }
+    // Check the eight alignments ending inside this byte, oldest first
+    for (int k = 7; k >= 0; k--) {
+      uint64_t m = (w >> k) & BZ_MAGIC_MASK;
+      if (m != BZ_BLOCK_MAGIC && m != BZ_EOS_MAGIC) {
+        continue;
+      }
+      uint64_t end = (uint64_t)(i + 1) * 8 - k;
+      if (end < 48) {
+        continue;
+      }
+      if (nmarks == cap) {
+        cap *= 2;
+        uint64_t *nm = realloc(marks, cap * sizeof(uint64_t));
+        uint8_t *nb = realloc(is_block, cap);
+        if (nm) marks = nm;
+        if (nb) is_block = nb;
+        if (!nm || !nb) {
+          free(marks);
+          free(is_block);
+          return 0;
+        }
+      }
+      marks[nmarks] = end - 48;
+      is_block[nmarks] = (m == BZ_BLOCK_MAGIC);
+      nmarks++;
+    }
+  }
+
+  t->blk_start = malloc((nmarks + 1) * sizeof(uint64_t));
+  t->blk_end = malloc((nmarks + 1) * sizeof(uint64_t));
+  if (!t->blk_start || !t->blk_end) {
+    free(marks);
+    free(is_block);
+    return 0;
+  }
+  t->nblocks = 0;
+  t->level = 1;
+  for (size_t j = 0; j < nmarks; j++) {
+    if (!is_block[j]) {
+      continue;
+    }
+    // The first block of each concatenated stream directly follows
+    // its byte aligned "BZh<level>" header
+    size_t at = marks[j] >> 3;
+    if ((marks[j] & 7) == 0 && at >= 4 &&
+        !memcmp(t->cdata + at - 4, "BZh", 3) &&
+        t->cdata[at - 1] >= '1' && t->cdata[at - 1] <= '9' &&
+        t->cdata[at - 1] - '0' > t->level) {
+      t->level = t->cdata[at - 1] - '0';
+    }
+    t->blk_start[t->nblocks] = marks[j];
+    t->blk_end[t->nblocks] = (j + 1 < nmarks) ? marks[j + 1]
+                                                : (uint64_t)t->csize * 8;
+    t->nblocks++;
+  }
+
+  free(marks);
+  free(is_block);
+  return 1;
+}
+
+//------------------------------------//
+//         Block Decompression        //
+//------------------------------------//
+
+// Wrap block 'b' into a single-block bzip2 stream and decode it.
+// For a single-block stream the combined CRC equals the block CRC,
+// which directly follows the block magic.
+//
+// Returns True if Successful
+//
+static int
+decode_block(trace_t *t, int b, char **out, size_t *out_len)
+{
+  uint64_t start = t->blk_start[b];
+  uint64_t nbits = t->blk_end[b] - start;
+  size_t in_size = 4 + (size_t)((nbits + 7) >> 3) + 11;
+  unsigned char *in = calloc(in_size, 1);
+  if (!in || nbits < 80) {
+    free(in);
+    return 0;
+  }
+
+  // Stream header, always level 9 so that any block size is accepted
+  memcpy(in, "BZh9", 4);
+
+  // Block body, shifted down to a byte boundary
+  size_t src = start >> 3;
+  int shift = start & 7;
+  size_t nbytes = nbits >> 3;
+  for (size_t i = 0; i < nbytes; i++) {
+    in[4 + i] = (get_byte(t->cdata, t->csize, src + i) << shift)
+              | (get_byte(t->cdata, t->csize, src + i + 1) >> (8 - shift));
+  }
+  uint64_t pos = (uint64_t)(4 + nbytes) * 8;
+  put_bits(in, &pos, get_bits(t->cdata, t->csize, start + nbytes * 8,
+                              nbits & 7), nbits & 7);
+
+  // Stream trailer
+  put_bits(in, &pos, BZ_EOS_MAGIC, 48);
+  put_bits(in, &pos, get_bits(t->cdata, t->csize, start + 48, 32), 32);
+
+  size_t cap = (size_t)9 * BZ_LEVEL_BYTES + (BZ_LEVEL_BYTES >> 1);
+  char *data = malloc(cap);
+  bz_stream bz;
+  memset(&bz, 0, sizeof(bz));
+  if (!data || BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK) {
+    free(data);
+    free(in);
+    return 0;
+  }
+  bz.next_in = (char *)in;
+  bz.avail_in = (unsigned)((pos + 7) >> 3);
+
+  size_t len = 0;
+  int ret;
+  for (;;) {
+    if (len == cap) {
+      char *grown = realloc(data, cap * 2);
+      if (!grown) {
+        ret = BZ_MEM_ERROR;
+        break;
+      }
+      data = grown;
+      cap *= 2;
+    }
+    size_t room = cap - len;
+    bz.next_out = data + len;
+    bz.avail_out = room > UINT_MAX ? UINT_MAX : (unsigned)room;
+    unsigned before = bz.avail_out;
+    ret = BZ2_bzDecompress(&bz);
+    len += before - bz.avail_out;
+    if (ret != BZ_OK) {
+      break;
+    }
+    if (bz.avail_in == 0 && before == bz.avail_out) {
+      ret = BZ_UNEXPECTED_EOF;
+      break;
+    }
+  }
+  BZ2_bzDecompressEnd(&bz);
+  free(in);
+
+  if (ret != BZ_STREAM_END) {
+    free(data);
+    return 0;
+  }
+  *out = data;
+  *out_len = len;
+  return 1;
+}
+
+static void *
+worker_main(void *arg)
+{
+  trace_t *t = arg;
+
+  pthread_mutex_lock(&t->lock);
+  for (;;) {
+    while (!t->stop && t->next_block < t->nblocks &&
+           t->next_block >= t->cur_block + t->window) {
+      pthread_cond_wait(&t->work_cv, &t->lock);
+    }
+    if (t->stop || t->next_block >= t->nblocks) {
+      break;
+    }
+    int b = t->next_block++;
+    struct slot *s = &t->slots[b % t->window];
+    s->state = SLOT_BUSY;
+    pthread_mutex_unlock(&t->lock);
+
+    char *data = NULL;
+    size_t len = 0;
+    int ok = decode_block(t, b, &data, &len);
+
+    pthread_mutex_lock(&t->lock);
+    s->data = data;
+    s->len = len;
+    s->state = ok ? SLOT_READY : SLOT_FAILED;
+    pthread_cond_broadcast(&t->done_cv);
+  }
+  pthread_mutex_unlock(&t->lock);
+
+  return NULL;
+}
+
+static void
+stop_workers(trace_t *t)
+{
+  if (!t->workers) {
+    return;
+  }
+  pthread_mutex_lock(&t->lock);
+  t->stop = 1;
+  pthread_cond_broadcast(&t->work_cv);
+  pthread_mutex_unlock(&t->lock);
+
+  for (int i = 0; i < t->nworkers; i++) {
+    pthread_join(t->workers[i], NULL);
+  }
+  for (int i = 0; i < t->window; i++) {
+    free(t->slots[i].data);
+  }
+  free(t->workers);
+  free(t->slots);
+  t->workers = NULL;
+  t->slots = NULL;
+  pthread_mutex_destroy(&t->lock);
+  pthread_cond_destroy(&t->work_cv);
+  pthread_cond_destroy(&t->done_cv);
+}
+
+static int
+start_workers(trace_t *t, int nthreads, size_t mem_budget)
+{
+  t->window = (int)(mem_budget / ((size_t)t->level * BZ_LEVEL_BYTES));
+  if (t->window < 1) {
+    t->window = 1;
+  }
+  if (t->window > t->nblocks) {
+    t->window = t->nblocks > 0 ? t->nblocks : 1;
+  }
+  t->nworkers = nthreads < t->window ? nthreads : t->window;
+
+  t->slots = calloc(t->window, sizeof(struct slot));
+  t->workers = calloc(t->nworkers, sizeof(pthread_t));
+  if (!t->slots || !t->workers) {
+    free(t->slots);
+    free(t->workers);
+    t->slots = NULL;
+    t->workers = NULL;
+    return 0;
+  }
+  pthread_mutex_init(&t->lock, NULL);
+  pthread_cond_init(&t->work_cv, NULL);
+  pthread_cond_init(&t->done_cv, NULL);
+
+  for (int i = 0; i < t->nworkers; i++) {
+    if (pthread_create(&t->workers[i], NULL, worker_main, t) != 0) {
+      t->nworkers = i;
+      stop_workers(t);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+//------------------------------------//
+//           Chunk Sources            //
+//------------------------------------//
+
+// Decode the whole file with a single libbz2 stream, discarding the
+// 'bz_skip' bytes that were already delivered by the parallel path
+//
+static int
+serial_next_chunk(trace_t *t)
+{
+  for (;;) {
+    if (!t->bz_live) {
+      if (t->bz_off + 4 > t->csize ||
+          memcmp(t->cdata + t->bz_off, "BZh", 3) != 0) {
+        return 0;
+      }
+      memset(&t->bz, 0, sizeof(t->bz));
+      if (BZ2_bzDecompressInit(&t->bz, 0, 0) != BZ_OK) {
+        t->error = 1;
+        return 0;
+      }
+      t->bz.next_in = (char *)t->cdata + t->bz_off;
+      t->bz_live = 1;
+    }
+    if (t->bz.avail_in == 0) {
+      size_t rest = t->csize - ((const unsigned char *)t->bz.next_in - t->cdata);
+      t->bz.avail_in = rest > UINT_MAX ? UINT_MAX : (unsigned)rest;
+    }
+    t->bz.next_out = t->serbuf;
+    t->bz.avail_out = SERIAL_CHUNK;
+
+    int ret = BZ2_bzDecompress(&t->bz);
+    size_t n = SERIAL_CHUNK - t->bz.avail_out;
+    if (ret == BZ_STREAM_END) {
+      // Concatenated streams are decoded back to back
+      t->bz_off = (const unsigned char *)t->bz.next_in - t->cdata;
+      BZ2_bzDecompressEnd(&t->bz);
+      t->bz_live = 0;
+    } else if (ret != BZ_OK || (n == 0 && t->bz.avail_in == 0)) {
+      t->error = 1;
+      return 0;
+    }
+
+    if (t->bz_skip >= n) {
+      t->bz_skip -= n;
+      continue;
+    }
+    t->chunk = t->serbuf + t->bz_skip;
+    t->chunk_len = n - t->bz_skip;
+    t->bz_skip = 0;
+    return 1;
+  }
+}
+
+// A block did not decode on its own (a magic number can occur by
+// chance inside compressed data).  Fall back to decoding serially.
+//
+static int
+switch_to_serial(trace_t *t)
+{
+  stop_workers(t);
+  t->serbuf = malloc(SERIAL_CHUNK);
+  if (!t->serbuf) {
+    t->error = 1;
+    return 0;
+  }
+  t->src = SRC_BZ2_SERIAL;
+  t->bz_off = 0;
+  t->bz_skip = t->delivered;
+  return 1;
+}
+
+static int
+parallel_next_chunk(trace_t *t)
+{
+  pthread_mutex_lock(&t->lock);
+  if (t->holding) {
+    struct slot *prev = &t->slots[t->cur_block % t->window];
+    free(prev->data);
+    prev->data = NULL;
+    prev->state = SLOT_EMPTY;
+    t->holding = 0;
+    t->cur_block++;
+    pthread_cond_broadcast(&t->work_cv);
+  }
+  if (t->cur_block >= t->nblocks) {
+    pthread_mutex_unlock(&t->lock);
+    return 0;
+  }
+
+  struct slot *s = &t->slots[t->cur_block % t->window];
+  while (s->state != SLOT_READY && s->state != SLOT_FAILED) {
+    pthread_cond_wait(&t->done_cv, &t->lock);
+  }
+  if (s->state == SLOT_FAILED) {
+    pthread_mutex_unlock(&t->lock);
+    return switch_to_serial(t) && serial_next_chunk(t);
+  }
+  t->chunk = s->data;
+  t->chunk_len = s->len;
+  t->holding = 1;
+  pthread_mutex_unlock(&t->lock);
+
+  return 1;
+}
+
+// Fetch the next chunk of decoded trace text
+//
+// Returns True if Successful, False at the end of the trace
+//
+static int
+next_chunk(trace_t *t)
+{
+  int ok;
+
+  switch (t->src) {
+    case SRC_STDIO:
+      t->chunk = t->iobuf;
+      t->chunk_len = fread(t->iobuf, 1, STDIO_CHUNK, t->fp);
+      ok = t->chunk_len > 0;
+      break;
+    case SRC_BZ2_PARALLEL:
+      ok = parallel_next_chunk(t);
+      break;
+    case SRC_BZ2_SERIAL:
+      ok = serial_next_chunk(t);
+      break;
+    default:
+      ok = 0;
+  }
+
+  t->chunk_pos = 0;
+  if (ok) {
+    t->delivered += t->chunk_len;
+  } else {
+    // The last chunk may already be freed
+    t->chunk = NULL;
+    t->chunk_len = 0;
+  }
+  return ok;
+}
+
+//------------------------------------//
+//             Line Parser            //
+//------------------------------------//
+
+static int
+carry_append(trace_t *t, const char *p, size_t n)
+{
+  if (t->carry_len + n > t->carry_cap) {
+    size_t cap = t->carry_cap ? t->carry_cap : 64;
+    while (cap < t->carry_len + n) {
+      cap *= 2;
+    }
+    char *grown = realloc(t->carry, cap);
+    if (!grown) {
+      return 0;
+    }
+    t->carry = grown;
+    t->carry_cap = cap;
+  }
+  memcpy(t->carry + t->carry_len, p, n);
+  t->carry_len += n;
+  return 1;
+}
+
+// Find the next line, without its newline.  The returned pointer
+// stays valid until the next call.
+//
+static int
+next_line(trace_t *t, const char **line, size_t *len)
+{
+  t->carry_len = 0;
+  for (;;) {
+    if (t->chunk_pos < t->chunk_len) {
+      const char *p = t->chunk + t->chunk_pos;
+      size_t avail = t->chunk_len - t->chunk_pos;
+      const char *nl = memchr(p, '\n', avail);
+      if (nl) {
+        size_t n = nl - p;
+        t->chunk_pos += n + 1;
+        if (t->carry_len == 0) {
+          *line = p;
+          *len = n;
+          return 1;
+        }
+        if (!carry_append(t, p, n)) {
+          t->error = 1;
+          return 0;
+        }
+        *line = t->carry;
+        *len = t->carry_len;
+        return 1;
+      }
+      if (!carry_append(t, p, avail)) {
+        t->error = 1;
+        return 0;
+      }
+      t->chunk_pos = t->chunk_len;
+    }
+    if (t->eof || !next_chunk(t)) {
+      t->eof = 1;
+      if (t->carry_len > 0) {
+        *line = t->carry;
+        *len = t->carry_len;
+        return 1;
+      }
+      return 0;
+    }
+  }
+}
+
+static int
+hex_digit(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Equivalent of sscanf(line, "0x%x %d\n", pc, outcome) for
+// well-formed trace lines
+//
+static void
+parse_line(const char *p, size_t n, uint32_t *pc, uint8_t *outcome)
+{
+  const char *end = p + n;
+  uint32_t v = 0;
+  int d;
+
+  if (n < 3 || p[0] != '0' || p[1] != 'x' || hex_digit(p[2]) < 0) {
+    return;
+  }
+  for (p += 2; p < end && (d = hex_digit(*p)) >= 0; p++) {
+    v = (v << 4) | d;
+  }
+  *pc = v;
+
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    p++;
+  }
+  int neg = 0;
+  if (p < end && (*p == '-' || *p == '+')) {
+    neg = (*p++ == '-');
+  }
+  if (p >= end || *p < '0' || *p > '9') {
+    return;
+  }
+  int o = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    o = o * 10 + (*p - '0');
+  }
+  *outcome = (uint8_t)(neg ? -o : o);
+}
+
+// Read the next binary record into 'rec'
+//
+static int
+next_record(trace_t *t, uint8_t rec[TRACE_RECORD])
+{
+  size_t got = 0;
+
+  while (got < TRACE_RECORD) {
+    if (t->chunk_pos == t->chunk_len) {
+      if (t->eof || !next_chunk(t)) {
+        t->eof = 1;
+        if (got > 0) {
+          t->error = 1;
+        }
+        return 0;
+      }
+      continue;
+    }
+    size_t k = t->chunk_len - t->chunk_pos;
+    if (k > TRACE_RECORD - got) {
+      k = TRACE_RECORD - got;
+    }
+    memcpy(rec + got, t->chunk + t->chunk_pos, k);
+    t->chunk_pos += k;
+    got += k;
+  }
+  return 1;
+}
+
+// Look at the start of the trace to tell binary from text
+//
+static void
+detect_format(trace_t *t)
+{
+  t->started = 1;
+  if (!next_chunk(t)) {
+    t->eof = 1;
+    return;
+  }
+  if (t->chunk_len >= TRACE_HEADER && !memcmp(t->chunk, TRACE_MAGIC, 4)) {
+    if (t->chunk[4] != TRACE_VERSION) {
+      t->error = 1;
+      t->eof = 1;
+      t->chunk_pos = t->chunk_len;
+      return;
+    }
+    t->binary = 1;
+    t->chunk_pos = TRACE_HEADER;
+  }
+}
+
+//------------------------------------//
+//            Trace Interface         //
+//------------------------------------//
+
+static int
+is_bzip2(const unsigned char *p, size_t n)
+{
+  return n >= 10 && p[0] == 'B' && p[1] == 'Z' && p[2] == 'h' &&
+         p[3] >= '1' && p[3] <= '9' &&
+         (!memcmp(p + 4, "\x31\x41\x59\x26\x53\x59", 6) ||
+          !memcmp(p + 4, "\x17\x72\x45\x38\x50\x90", 6));
+}
+
+trace_t *
+trace_open(const char *path, int nthreads, size_t mem_budget)
+{
+  trace_t *t = calloc(1, sizeof(trace_t));
+  if (!t) {
+    return NULL;
+  }
+  if (nthreads <= 0) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = n > 0 ? (int)n : 1;
+  }
+  if (mem_budget == 0) {
+    mem_budget = TRACE_DEFAULT_BUDGET;
+  }
+
+  if (path == NULL || !strcmp(path, "-")) {
+    t->fp = stdin;
+  } else {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0) close(fd);
+      free(t);
+      return NULL;
+    }
+
+    void *map = MAP_FAILED;
+    if (S_ISREG(st.st_mode) && st.st_size >= 10) {
+      map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (map != MAP_FAILED && is_bzip2(map, st.st_size)) {
+      close(fd);
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      t->cdata = map;
+      t->csize = st.st_size;
+      t->src = SRC_BZ2_PARALLEL;
+      if (!scan_blocks(t) || !start_workers(t, nthreads, mem_budget)) {
+        // Still readable, just not in parallel
+        stop_workers(t);
+        if (!switch_to_serial(t)) {
+          trace_close(t);
+          return NULL;
+        }
+      }
+      return t;
+    }
+    if (map != MAP_FAILED) {
+      munmap(map, st.st_size);
+    }
+    t->fp = fdopen(fd, "r");
+    if (!t->fp) {
+      close(fd);
+      free(t);
+      return NULL;
+    }
+  }
+
+  t->src = SRC_STDIO;
+  t->iobuf = malloc(STDIO_CHUNK);
+  if (!t->iobuf) {
+    trace_close(t);
+    return NULL;
+  }
+  return t;
+}
+
+int
+trace_read_branch(trace_t *t, uint32_t *pc, uint8_t *outcome)
+{
+  const char *line;
+  size_t len;
+
+  if (!t->started) {
+    detect_format(t);
+  }
+
+  if (t->binary) {
+    uint8_t rec[TRACE_RECORD];
+    if (!next_record(t, rec)) {
+      return 0;
+    }
+    *pc = rec[0] | (rec[1] << 8) | (rec[2] << 16) | ((uint32_t)rec[3] << 24);
+    *outcome = rec[4];
+    return 1;
+  }
+
+  if (!next_line(t, &line, &len)) {
+    return 0;
+  }
+  parse_line(line, len, pc, outcome);
+
+  return 1;
+}
+
+int
+trace_error(trace_t *t)
+{
+  return t->error;
+}
+
+void
+trace_close(trace_t *t)
+{
+  if (!t) {
+    return;
+  }
+  stop_workers(t);
+  if (t->bz_live) {
+    BZ2_bzDecompressEnd(&t->bz);
+  }
+  if (t->cdata) {
+    munmap((void *)t->cdata, t->csize);
+  }
+  if (t->fp && t->fp != stdin) {
+    fclose(t->fp);
+  }
+  free(t->blk_start);
+  free(t->blk_end);
+  free(t->serbuf);
+  free(t->iobuf);
+  free(t->carry);
+  free(t);
+}
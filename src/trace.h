@@ -0,0 +1,55 @@
+//========================================================//
+//  trace.h                                               //
+//  Header file for the Trace Reader                      //
+//                                                        //
+//  Reads "0x<pc> <outcome>" or binary branch traces from //
+//  stdin, a plain file or a .bz2 file.  bzip2 files are  //
+//  split at block boundaries and the blocks are decoded  //
+//  concurrently on a pool of worker threads.             //
+//========================================================//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Default upper bound on decoded-but-unparsed trace data
+// held in memory by the parallel bzip2 reader
+#define TRACE_DEFAULT_BUDGET  (64u << 20)
+
+// Binary trace layout: an 8 byte header, "BPTR", uint8 version (1)
+// and 3 bytes zero, followed by one TRACE_RECORD byte record per
+// branch: uint32 pc, little endian, and uint8 outcome.  Binary traces
+// are recognized by their header, compressed or not.
+#define TRACE_MAGIC    "BPTR"
+#define TRACE_VERSION  1
+#define TRACE_HEADER   8
+#define TRACE_RECORD   5
+
+typedef struct trace trace_t;
+
+// Open the trace at 'path' (NULL or "-" reads stdin).  'nthreads' is
+// the number of bzip2 decoder threads, 0 picks one per online core.
+// 'mem_budget' bounds the decoded data buffered ahead of the parser,
+// 0 selects TRACE_DEFAULT_BUDGET.
+//
+// Returns NULL if the trace cannot be opened
+//
+trace_t *trace_open(const char *path, int nthreads, size_t mem_budget);
+
+// Reads the next branch from the trace
+//
+// Returns True if Successful, False at the end of the trace
+//
+int trace_read_branch(trace_t *t, uint32_t *pc, uint8_t *outcome);
+
+// Returns True if the trace hit a decompression error
+//
+int trace_error(trace_t *t);
+
+// Close the trace and release its buffers and threads
+//
+void trace_close(trace_t *t);
+
+#endif
@@ -0,0 +1,424 @@
+//========================================================//
+//  tracegen.c                                            //
+//  Synthetic Branch Trace Generator                      //
+//                                                        //
+//  Writes reproducible traces of arbitrary length in the //
+//  "0x<pc> <outcome>" format or the binary format read   //
+//  by trace.c, from a configurable mix of branch         //
+//  behaviours over a configurable number of static       //
+//  branches.                                             //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "trace.h"
+
+#define OUT_BUFFER  (1u << 20)
+
+// Branch behaviours
+#define LOOP        0   // taken trip-1 times, then not taken
+#define BIASED      1   // taken with a fixed, strongly skewed probability
+#define CORRELATED  2   // repeats or inverts an earlier global outcome
+#define RANDOM      3   // taken half of the time
+#define ALIAS       4   // biased, sharing low pc bits with branches of
+                        // the opposite bias
+#define NUM_KINDS   5
+
+const char *kindName[NUM_KINDS] = { "loop", "biased", "correlated",
+                                    "random", "alias" };
+
+// Static branch
+typedef struct {
+  uint32_t pc;
+  int kind;
+  uint32_t trip;       // LOOP: iterations per execution
+  uint32_t body;       // LOOP: branches executed per iteration
+  uint32_t p_taken;    // BIASED, ALIAS: probability * 2^32
+  int hist;            // CORRELATED: history position
+  uint8_t invert;      // CORRELATED: negate that outcome
+} branch_t;
+
+//------------------------------------//
+//       Generator Configuration      //
+//------------------------------------//
+
+uint64_t num_branches = 10000000;
+uint32_t num_statics = 1000;
+uint64_t seed = 1;
+int binary = 0;
+double mix[NUM_KINDS] = { 30, 30, 20, 10, 10 };
+char *out_path = NULL;
+
+//------------------------------------//
+//          Generator State           //
+//------------------------------------//
+
+branch_t *statics;
+uint64_t rng_state;
+uint64_t ghistory;
+uint64_t emitted;
+
+FILE *out;
+char *outbuf;
+size_t outlen;
+
+// splitmix64
+//
+uint64_t
+rng_next()
+{
+  uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform integer in [0, n)
+//
+uint32_t
+rng_below(uint32_t n)
+{
+  return (uint32_t)(((rng_next() >> 32) * (uint64_t)n) >> 32);
+}
+
+// Uniform double in [0, 1)
+//
+double
+rng_unit()
+{
+  return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void
+usage()
+{
+  fprintf(stderr,"Usage: tracegen <options>\n");
+  fprintf(stderr," Options:\n");
+  fprintf(stderr," --help             Print this message\n");
+  fprintf(stderr," --branches:<n>     Dynamic branches to emit (default 10000000)\n");
+  fprintf(stderr," --statics:<n>      Static branches (default 1000)\n");
+  fprintf(stderr," --seed:<n>         Random seed (default 1)\n");
+  fprintf(stderr," --mix:<kind>=<w>,... Relative weight of each kind of static\n"
+                 "                    branch: loop, biased, correlated, random,\n"
+                 "                    alias (default 30,30,20,10,10)\n");
+  fprintf(stderr," --binary           Write the binary trace format\n");
+  fprintf(stderr," --out:<file>       Write to <file> instead of stdout\n");
+}
+
+// Parse "kind=w,kind=w,..."
+//
+// Returns True if Successful
+//
+int
+parse_mix(char *spec)
+{
+  double m[NUM_KINDS] = { 0 };
+  double total = 0;
+
+  for (char *tok = strtok(spec, ","); tok; tok = strtok(NULL, ",")) {
+    char *eq = strchr(tok, '=');
+    int k;
+    if (!eq) {
+      return 0;
+    }
+    *eq = '\0';
+    for (k = 0; k < NUM_KINDS && strcmp(tok, kindName[k]); k++)
+      ;
+    if (k == NUM_KINDS || atof(eq + 1) < 0) {
+      return 0;
+    }
+    m[k] = atof(eq + 1);
+    total += m[k];
+  }
+  if (total <= 0) {
+    return 0;
+  }
+  memcpy(mix, m, sizeof(mix));
+  return 1;
+}
+
+int
+handle_option(char *arg)
+{
+  if (!strncmp(arg,"--branches:",11)) {
+    num_branches = strtoull(arg + 11, NULL, 0);
+  } else if (!strncmp(arg,"--statics:",10)) {
+    num_statics = strtoul(arg + 10, NULL, 0);
+  } else if (!strncmp(arg,"--seed:",7)) {
+    seed = strtoull(arg + 7, NULL, 0);
+  } else if (!strncmp(arg,"--mix:",6)) {
+    return parse_mix(arg + 6);
+  } else if (!strcmp(arg,"--binary")) {
+    binary = 1;
+  } else if (!strncmp(arg,"--out:",6)) {
+    out_path = arg + 6;
+  } else {
+    return 0;
+  }
+
+  return num_statics > 0;
+}
+
+//------------------------------------//
+//           Static Branches          //
+//------------------------------------//
+
+int
+pick_kind()
+{
+  double total = 0;
+  for (int k = 0; k < NUM_KINDS; k++) {
+    total += mix[k];
+  }
+  double u = rng_unit() * total;
+  for (int k = 0; k < NUM_KINDS; k++) {
+    if (u < mix[k]) {
+      return k;
+    }
+    u -= mix[k];
+  }
+  return BIASED;
+}
+
+uint32_t
+strong_bias()
+{
+  // 90% to 99% towards a random direction
+  double p = 0.90 + 0.09 * rng_unit();
+  if (rng_next() & 1) {
+    p = 1.0 - p;
+  }
+  return (uint32_t)(p * 4294967295.0);
+}
+
+void
+init_statics()
+{
+  statics = malloc(num_statics * sizeof(branch_t));
+  if (!statics) {
+    fprintf(stderr,"Out of memory\n");
+    exit(1);
+  }
+
+  // Lay the branches out like code, a few instructions apart
+  uint32_t pc = 0x400000;
+  uint32_t alias_base = 0;
+  int alias_left = 0;
+  uint32_t *aliases = calloc(0x10000, sizeof(uint32_t));
+  if (!aliases) {
+    fprintf(stderr,"Out of memory\n");
+    exit(1);
+  }
+
+  for (uint32_t i = 0; i < num_statics; i++) {
+    branch_t *b = &statics[i];
+    memset(b, 0, sizeof(branch_t));
+    pc += 2 + 2 * rng_below(16);
+    b->pc = pc;
+    b->kind = pick_kind();
+
+    switch (b->kind) {
+      case LOOP:
+        b->trip = 2 + rng_below(63);
+        b->body = rng_below(4);
+        break;
+      case BIASED:
+        b->p_taken = strong_bias();
+        break;
+      case CORRELATED:
+        b->hist = 1 + rng_below(16);
+        b->invert = rng_next() & 1;
+        break;
+      case ALIAS:
+        // Groups of up to four branches with identical low 16 pc bits
+        // and alternating bias directions
+        if (alias_left == 0) {
+          alias_base = b->pc;
+          alias_left = 2 + rng_below(3);
+          b->p_taken = strong_bias();
+        } else {
+          uint32_t prev = statics[i - 1].kind == ALIAS ?
+                          statics[i - 1].p_taken : strong_bias();
+          // Placed above the code once its end is known, see below
+          b->pc = alias_base & 0xffff;
+          b->p_taken = 0xffffffffu - prev;
+        }
+        alias_left--;
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Give the rest of each alias group the low 16 pc bits of its first
+  // branch, in 64K pages above the last branch so that no two static
+  // branches share a pc
+  uint32_t top = (pc >> 16) + 1;
+  for (uint32_t i = 0; i < num_statics; i++) {
+    if (statics[i].pc < 0x10000) {
+      statics[i].pc |= (top + aliases[statics[i].pc]++) << 16;
+    }
+  }
+  free(aliases);
+}
+
+// Pick the next static branch to execute.  Popularity falls off with
+// the index, so a few branches are hot and the rest form a long tail.
+//
+uint32_t
+pick_static()
+{
+  double u = rng_unit();
+  return (uint32_t)(u * u * u * num_statics);
+}
+
+//------------------------------------//
+//               Output               //
+//------------------------------------//
+
+void
+flush_out()
+{
+  if (outlen > 0 && fwrite(outbuf, 1, outlen, out) != outlen) {
+    perror("tracegen");
+    exit(1);
+  }
+  outlen = 0;
+}
+
+void
+emit(uint32_t pc, uint8_t outcome)
+{
+  if (outlen + 32 > OUT_BUFFER) {
+    flush_out();
+  }
+
+  char *p = outbuf + outlen;
+  if (binary) {
+    p[0] = pc;
+    p[1] = pc >> 8;
+    p[2] = pc >> 16;
+    p[3] = pc >> 24;
+    p[4] = outcome;
+    p += TRACE_RECORD;
+  } else {
+    static const char hex[] = "0123456789abcdef";
+    char digits[8];
+    int n = 0;
+    do {
+      digits[n++] = hex[pc & 0xf];
+      pc >>= 4;
+    } while (pc);
+    *p++ = '0';
+    *p++ = 'x';
+    while (n > 0) {
+      *p++ = digits[--n];
+    }
+    *p++ = ' ';
+    *p++ = '0' + outcome;
+    *p++ = '\n';
+  }
+  outlen = p - outbuf;
+
+  ghistory = (ghistory << 1) | outcome;
+  emitted++;
+}
+
+//------------------------------------//
+//             Generation             //
+//------------------------------------//
+
+uint8_t
+outcome_of(branch_t *b)
+{
+  switch (b->kind) {
+    case BIASED:
+    case ALIAS:
+      return (rng_next() >> 32) < b->p_taken;
+    case CORRELATED: {
+      uint8_t o = ((ghistory >> (b->hist - 1)) & 1) ^ b->invert;
+      // 2% noise
+      return rng_below(50) == 0 ? !o : o;
+    }
+    case RANDOM:
+    default:
+      return rng_next() & 1;
+  }
+}
+
+// Execute static branch 'i'.  A loop branch runs all of its
+// iterations, each preceded by the non-loop branches that follow it.
+//
+void
+execute(uint32_t i)
+{
+  branch_t *b = &statics[i];
+
+  if (b->kind != LOOP) {
+    emit(b->pc, outcome_of(b));
+    return;
+  }
+
+  for (uint32_t it = 0; it < b->trip && emitted < num_branches; it++) {
+    for (uint32_t j = 1; j <= b->body && emitted < num_branches; j++) {
+      branch_t *inner = &statics[(i + j) % num_statics];
+      if (inner->kind != LOOP) {
+        emit(inner->pc, outcome_of(inner));
+      }
+    }
+    if (emitted < num_branches) {
+      emit(b->pc, it + 1 < b->trip ? 1 : 0);
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i],"--help")) {
+      usage();
+      exit(0);
+    } else if (!handle_option(argv[i])) {
+      printf("Unrecognized option %s\n", argv[i]);
+      usage();
+      exit(1);
+    }
+  }
+
+  out = stdout;
+  if (out_path != NULL && (out = fopen(out_path, "w")) == NULL) {
+    perror(out_path);
+    exit(1);
+  }
+  outbuf = malloc(OUT_BUFFER);
+  if (!outbuf) {
+    fprintf(stderr,"Out of memory\n");
+    exit(1);
+  }
+
+  rng_state = seed;
+  init_statics();
+
+  if (binary) {
+    char hdr[TRACE_HEADER] = { 'B', 'P', 'T', 'R', TRACE_VERSION, 0, 0, 0 };
+    memcpy(outbuf, hdr, TRACE_HEADER);
+    outlen = TRACE_HEADER;
+  }
+  while (emitted < num_branches) {
+    execute(pick_static());
+  }
+  flush_out();
+
+  if (fclose(out) != 0) {
+    perror("tracegen");
+    exit(1);
+  }
+  free(outbuf);
+  free(statics);
+
+  return 0;
+}